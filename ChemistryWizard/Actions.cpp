@@ -1,9 +1,13 @@
 #include "Actions.h"
+#include "Lexer.h"
 
 #include <algorithm>
 #include <concepts>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
+#include <limits>
+#include <numeric>
 #include <optional>
 #include <ranges>
 
@@ -113,175 +117,55 @@ inline auto print_text = [](const auto& obj) -> QString {
     return text;
 };
 
-inline auto range_to_view_strip = [](std::ranges::range auto&& range) {
-    // this (unnecessarily) convoluted function effectively does std::string_view view{range} -> return strip(view)
-    // where strip() removes all whitespace at the start and end of the range
-
-    size_t skipped = 0;
-    size_t range_size = std::ranges::distance(range);
-    auto it = std::ranges::begin(range);
-    auto end = std::ranges::end(range);
-    while (it != end && std::isspace(*it)) {
-        ++it;
-        skipped++;
+// stima per eccesso dello spazio necessario all'arena. I composti vengono letti in una sola passata, quindi i loro
+// vettori crescono per raddoppi: si conta il quadruplo degli elementi e un'allocazione in più per ogni crescita
+inline auto estimate_arena_size = [](auto argument) -> size_t {
+    using CharT = typename decltype(argument)::value_type;
+    size_t n_compounds = 2;
+    size_t n_upper = 0;
+    size_t n_groups = 0;
+    for (CharT c : argument) {
+        if (c == '+')
+            n_compounds++;
+        else if (c == '(' || c == '[' || c == '*' || c == static_cast<CharT>(0xB7)) // anche il punto degli idrati
+            n_groups++;
+        else if (c >= 'A' && c <= 'Z')
+            n_upper++;
     }
-    range_size -= skipped;
-    if (it == end || range_size == 0) return std::string_view{};
-    const auto* begin_ptr = &(*it);
-
-    // this is because the ranges iterator is only a forward iterator
-    std::string_view v{begin_ptr, range_size};
-    auto last_char = v.end() - 1;
-    while (std::isspace(*last_char)) {
-        --last_char;
-        range_size--;
-    }
-    return std::string_view{begin_ptr, range_size};
+    size_t n_allocations = 2 + n_compounds + n_upper + n_groups;
+    return 2 * n_compounds * sizeof(Composto) + 4 * (n_upper + n_groups) * sizeof(ElementQt) +
+           4 * n_upper * sizeof(SingleElementQt) + n_allocations * alignof(std::max_align_t);
 };
 
-enum class UpperState { Unknown, False, True };
-
-inline auto parse_group = [](std::string_view::const_iterator& it,
-                             std::string_view::const_iterator end) -> std::optional<GroupElementRef> {
-    std::vector<SingleElementQt> elements{};
-    std::string curr_elem{};
-    std::string curr_elem_size{};
-    bool previous_is_num = false;
-    auto previous_is_upper = UpperState::Unknown;
-    auto upper = UpperState::Unknown;
-    auto map_end = elements_map.end();
-    auto check_upper = [&]() {
-        return (upper == UpperState::True && previous_is_upper == UpperState::False) ||
-               (upper == UpperState::True && previous_is_upper == UpperState::True);
-    };
-    for (; it != end; ++it) {
-        auto c = *it;
-        bool num = std::isdigit(c) != 0;
-        upper = std::isupper(c) != 0 ? UpperState::True : UpperState::False;
-        if ((!num && previous_is_num) || check_upper() || c == ')') {
-            if (curr_elem.empty()) {
-                error_invalid_element(curr_elem, c);
-                return {};
-            }
-            auto it = elements_map.find(curr_elem);
-            if (it == map_end) {
-                error_invalid_element(curr_elem);
-                return {};
-            }
-            size_t sz = curr_elem_size.empty() ? 1 : std::stoull(curr_elem_size);
-            elements.emplace_back((*it).second, sz);
-            curr_elem_size.clear();
-            curr_elem.clear();
-            if (c == ')') break;
-            curr_elem += c;
-        } else if (num) {
-            curr_elem_size += c;
-        } else if (c == ')') {
-            ++it;
-            break;
-        } else {
-            curr_elem += c;
-            if (curr_elem.size() > 2) {
-                error_invalid_element(curr_elem);
-                return {};
-            }
-        }
-        previous_is_num = num;
-        previous_is_upper = upper;
-    }
-    if (!curr_elem.empty()) {
-        error_invalid_element(curr_elem);
-        return {};
-    }
-    return elements;
-};
+ReactionArena::Ptr ReactionArena::create(size_t size) {
+    // l'arena e il suo buffer stanno nello stesso blocco, così ogni reazione costa una sola allocazione
+    void* block = ::operator new(sizeof(ReactionArena) + size);
+    auto* buffer = static_cast<std::byte*>(block) + sizeof(ReactionArena);
+    return Ptr{new (block) ReactionArena{buffer, size}};
+}
 
-inline auto split_molecule_in_elements = [](std::string_view view) -> std::optional<Composto> {
-    std::vector<ElementQt> elements{};
-    std::string curr_elem{};
-    std::string curr_elem_size{};
-    std::string quantity_str{};
-    bool previous_is_num = false;
-    auto previous_is_upper = UpperState::Unknown;
-    auto upper = UpperState::Unknown;
-    auto map_end = elements_map.end();
-    auto check_upper = [&]() {
-        return (upper == UpperState::True && previous_is_upper == UpperState::False) ||
-               (upper == UpperState::True && previous_is_upper == UpperState::True);
-    };
-    GroupElementRef group{};
-    bool previous_was_group = false;
-
-    auto append_elem_or_group = [&](char c) -> bool {
-        size_t sz = curr_elem_size.empty() ? 1 : std::stoull(curr_elem_size);
-        if (previous_was_group) {
-            elements.push_back(ElementQt{std::in_place_index<1>, move(group), sz});
-            previous_was_group = false;
-        } else {
-            if (curr_elem.empty()) {
-                error_invalid_element(curr_elem, c);
-                return false;
-            }
-            auto it = elements_map.find(curr_elem);
-            if (it == map_end) {
-                error_invalid_element(curr_elem);
-                return false;
-            }
-            elements.push_back(ElementQt{std::in_place_index<0>, (*it).second, sz});
-            curr_elem_size.clear();
-            curr_elem.clear();
-            curr_elem += c;
-        }
-        return true;
-    };
+void ReactionArena::Deleter::operator()(ReactionArena* arena) const {
+    arena->~ReactionArena();
+    ::operator delete(arena);
+}
 
-    for (auto it = view.begin(); it != view.end(); ++it) {
-        auto c = *it;
-        bool num = std::isdigit(c) != 0;
-        if (num && upper == UpperState::Unknown) {
-            // numero prima della molecola, quindi la quantità.
-            quantity_str += c;
-            continue;
-        }
-        upper = std::isupper(c) != 0 ? UpperState::True : UpperState::False;
-        if ((!num && previous_is_num) || check_upper()) {
-            if (!append_elem_or_group(c)) { return {}; }
-        } else if (num) {
-            curr_elem_size += c;
-        } else if (c == '(') {
-            if (!append_elem_or_group(c)) { return {}; }
-            previous_was_group = true;
-            auto maybe_group = parse_group(++it, view.end());
-            if (!maybe_group.has_value()) { return {}; }
-            group = std::move(maybe_group.value());
-        } else {
-            curr_elem += c;
-            if (curr_elem.size() > 2) {
-                error_invalid_element(curr_elem);
-                return {};
-            }
-        }
-        previous_is_num = num;
-        previous_is_upper = upper;
-    }
-    size_t sz = curr_elem_size.empty() ? 1 : std::stoull(curr_elem_size);
-    if (previous_was_group) {
-        elements.emplace_back(ElementQt{std::in_place_index<1>, std::move(group), sz});
-    } else {
-        if (curr_elem.empty()) {
-            error_invalid_element(curr_elem);
-            return {};
-        }
-        auto it = elements_map.find(curr_elem);
-        if (it == map_end) {
-            error_invalid_element(curr_elem);
-            return {};
-        }
-        elements.emplace_back(ElementQt{std::in_place_index<0>, (*it).second, sz});
+void* ReactionArena::do_allocate(size_t bytes, size_t alignment) {
+    void* ptr = m_current;
+    size_t space = static_cast<size_t>(m_end - m_current);
+    if (std::align(alignment, bytes, ptr, space) != nullptr) {
+        m_current = static_cast<std::byte*>(ptr) + bytes;
+        return ptr;
     }
-    size_t quantity = quantity_str.empty() ? 1 : std::stoull(quantity_str);
-    return Composto{std::move(elements), quantity};
-};
+    m_allocations++;
+    return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void ReactionArena::do_deallocate(void* ptr, size_t bytes, size_t alignment) {
+    auto* p = static_cast<std::byte*>(ptr);
+    // la memoria dentro il blocco viene liberata solo insieme all'arena
+    if (std::less_equal{}(m_begin, p) && std::less{}(p, m_end)) return;
+    std::pmr::new_delete_resource()->deallocate(ptr, bytes, alignment);
+}
 
 int levenshtein_distance(std::string_view s1, std::string_view s2) {
     size_t m = s1.size();
@@ -330,40 +214,58 @@ void error_invalid_element(const std::string& element, char c) {
     }
 }
 
-QString do_balance(const std::string& argument) {
-    auto view = argument | std::views::split("->"sv) | std::views::transform(range_to_view_strip) | std::views::common;
-    if (std::ranges::distance(view) != 2) {
-        error("Formato della reazione non valido");
-        return last_error;
+QString format_formula(const Composto& composto, bool with_quantity) {
+    QString text{};
+    QTextStream stream{&text};
+    if (with_quantity && composto.quantity() != 1) stream << composto.quantity();
+    auto append_single = [&](const SingleElementQt& elem) {
+        stream << elem.element->name();
+        if (elem.quantity != 1) stream << elem.quantity;
+    };
+    for (const auto& variant : composto) {
+        if (std::holds_alternative<SingleElementQt>(variant)) {
+            append_single(std::get<SingleElementQt>(variant));
+        } else {
+            const auto& [group, size] = std::get<GroupElementQt>(variant);
+            stream << '(';
+            for (const auto& elem : group) {
+                append_single(elem);
+            }
+            stream << ')';
+            if (size != 1) stream << size;
+        }
+    }
+    if (composto.charge() != 0) {
+        stream << '^';
+        if (std::abs(composto.charge()) != 1) stream << std::abs(composto.charge());
+        stream << (composto.charge() > 0 ? '+' : '-');
     }
+    return text;
+}
 
-    bool had_error = false;
-    Reazione r{};
-    auto vit = view.begin();
-    std::ranges::copy(*vit | std::views::split('+') | std::views::transform(range_to_view_strip) |
-                      std::views::transform([&](std::string_view view) -> Composto {
-                          auto maybe_composto = split_molecule_in_elements(view);
-                          if (!maybe_composto.has_value()) {
-                              had_error = true;
-                              return Composto{{}, 0};
-                          }
-                          return maybe_composto.value();
-                      }),
-                      std::back_inserter(r.reagenti));
-    if (had_error) return last_error;
-    ++vit;
-    std::ranges::copy(*vit | std::views::split('+') | std::views::transform(range_to_view_strip) |
-                      std::views::transform([&](std::string_view view) -> Composto {
-                          auto maybe_composto = split_molecule_in_elements(view);
-                          if (!maybe_composto.has_value()) {
-                              had_error = true;
-                              return Composto{{}, 0};
-                          }
-                          return maybe_composto.value();
-                      }),
-                      std::back_inserter(r.prodotti));
-    if (had_error) return last_error;
+QString format_composto(const Composto& composto) {
+    return print_text(composto);
+}
 
+QString format_equazione(const Reazione& reazione) {
+    QString text{};
+    auto append_side = [&](const std::pmr::vector<Composto>& side) {
+        for (size_t i = 0; i < side.size(); i++) {
+            if (i != 0) text.append(" + ");
+            text.append(format_formula(side[i]));
+        }
+    };
+    append_side(reazione.reagenti);
+    text.append(" -> ");
+    append_side(reazione.prodotti);
+    return text;
+}
+
+QString format_risultato(const Risultato& risultato) {
+    if (!risultato.ok()) return risultato.errore;
+    if (!risultato.reazione.has_value()) return risultato.testo;
+
+    const auto& r = risultato.reazione.value();
     QString result{"Reagenti:\n"};
     for (const auto& reagente : r.reagenti) {
         result.append(print_text(reagente));
@@ -372,19 +274,529 @@ QString do_balance(const std::string& argument) {
     for (const auto& prodotto : r.prodotti) {
         result.append(print_text(prodotto));
     }
+    result.append(QString::asprintf("Allocazioni: %llu\n", static_cast<unsigned long long>(r.allocations())));
+    result.append(risultato.testo);
+    return result;
+}
 
+std::optional<std::vector<size_t>> solve_coefficients(const Reazione& reazione) {
+    // matrice elementi x composti (prodotti in negativo), ridotta a scala con interi esatti:
+    // esiste una soluzione unica solo se lo spazio nullo ha dimensione 1.
+    // la riga 0 (nessun elemento ha numero atomico 0) conserva la carica delle reazioni ioniche.
+    // ogni operazione è controllata; LLONG_MIN conta come overflow, così gcd e abs restano definiti
+    constexpr long long min = std::numeric_limits<long long>::min();
+    auto overflow = [] {
+        error("Numeri troppo grandi nella reazione");
+        return std::nullopt;
+    };
+    auto mul = [](long long a, long long b, long long& out) { return checked_mul(a, b, out) && out != min; };
+    auto add = [](long long a, long long b, long long& out) { return checked_add(a, b, out) && out != min; };
+
+    const size_t n = reazione.reagenti.size() + reazione.prodotti.size();
+    std::array<int, elements.size() + 1> row_of{};
+    row_of.fill(-1);
+    std::vector<std::vector<long long>> matrix{};
+    auto add_to_row = [&](size_t col, size_t index, long long amount) {
+        auto& row = row_of[index];
+        if (row < 0) {
+            row = static_cast<int>(matrix.size());
+            matrix.emplace_back(n, 0);
+        }
+        return add(matrix[row][col], amount, matrix[row][col]);
+    };
+    auto add_atoms = [&](size_t col, const SingleElementQt& elem, long long factor) {
+        long long amount = 0;
+        return mul(factor, static_cast<long long>(elem.quantity), amount) &&
+               add_to_row(col, static_cast<size_t>(elem.element->na()), amount);
+    };
+    for (size_t col = 0; col < n; col++) {
+        bool is_reagente = col < reazione.reagenti.size();
+        const auto& composto =
+        is_reagente ? reazione.reagenti[col] : reazione.prodotti[col - reazione.reagenti.size()];
+        long long sign = is_reagente ? 1 : -1;
+        for (const auto& variant : composto) {
+            if (std::holds_alternative<SingleElementQt>(variant)) {
+                if (!add_atoms(col, std::get<SingleElementQt>(variant), sign)) return overflow();
+            } else {
+                const auto& [group, size] = std::get<GroupElementQt>(variant);
+                long long factor = 0;
+                if (!mul(sign, static_cast<long long>(size), factor)) return overflow();
+                for (const auto& elem : group) {
+                    if (!add_atoms(col, elem, factor)) return overflow();
+                }
+            }
+        }
+        if (composto.charge() != 0 && !add_to_row(col, 0, sign * composto.charge())) return overflow();
+    }
+
+    std::vector<size_t> pivot_cols{};
+    size_t rank = 0;
+    for (size_t col = 0; col < n && rank < matrix.size(); col++) {
+        auto pivot = std::find_if(matrix.begin() + rank, matrix.end(), [&](const auto& row) { return row[col] != 0; });
+        if (pivot == matrix.end()) continue;
+        std::iter_swap(matrix.begin() + rank, pivot);
+        const auto& pivot_row = matrix[rank];
+        for (size_t i = 0; i < matrix.size(); i++) {
+            if (i == rank || matrix[i][col] == 0) continue;
+            long long a = pivot_row[col];
+            long long b = matrix[i][col];
+            long long g = 0;
+            for (size_t j = 0; j < n; j++) {
+                // matrix[i][j] * a - pivot_row[j] * b
+                long long left = 0;
+                long long right = 0;
+                if (!mul(matrix[i][j], a, left) || !mul(pivot_row[j], -b, right) ||
+                    !add(left, right, matrix[i][j])) {
+                    return overflow();
+                }
+                g = std::gcd(g, matrix[i][j]);
+            }
+            if (g > 1) {
+                for (auto& v : matrix[i]) v /= g;
+            }
+        }
+        pivot_cols.push_back(col);
+        rank++;
+    }
+    if (n - rank != 1) return {};
+
+    size_t free_col = 0;
+    while (std::ranges::find(pivot_cols, free_col) != pivot_cols.end()) free_col++;
+    long long free_value = 1;
+    for (size_t k = 0; k < rank; k++) {
+        long long pivot = std::abs(matrix[k][pivot_cols[k]]);
+        if (!mul(free_value / std::gcd(free_value, pivot), pivot, free_value)) return overflow();
+    }
+    std::vector<long long> solution(n, 0);
+    solution[free_col] = free_value;
+    for (size_t k = 0; k < rank; k++) {
+        long long product = 0;
+        if (!mul(matrix[k][free_col], free_value, product)) return overflow();
+        solution[pivot_cols[k]] = -product / matrix[k][pivot_cols[k]];
+    }
+
+    long long g = 0;
+    for (auto v : solution) g = std::gcd(g, v);
+    if (solution[0] < 0) g = -g;
+    std::vector<size_t> coefficients(n, 0);
+    for (size_t i = 0; i < n; i++) {
+        long long v = solution[i] / g;
+        if (v <= 0) return {};
+        coefficients[i] = static_cast<size_t>(v);
+    }
+    return coefficients;
+}
+
+void apply_coefficients(Reazione& reazione, const std::vector<size_t>& coefficients) {
+    size_t i = 0;
+    for (auto& reagente : reazione.reagenti) {
+        reagente.set_quantity(coefficients[i++]);
+    }
+    for (auto& prodotto : reazione.prodotti) {
+        prodotto.set_quantity(coefficients[i++]);
+    }
+}
+
+bool balance_reaction(Reazione& reazione) {
+    auto coefficients = solve_coefficients(reazione);
+    if (!coefficients.has_value()) return false;
+    apply_coefficients(reazione, coefficients.value());
+    return true;
+}
+
+static void error_token(const Token& tok) {
+    if (tok.tipo == TipoToken::NonValido && tok.valore == Token::numero_troppo_grande)
+        error("Numero troppo grande");
+    else if (tok.tipo == TipoToken::NonValido)
+        error("Carattere non valido: U+%04llX", tok.valore);
+    else
+        error("Formato della reazione non valido");
+}
+
+// legge i composti separati da `+`: quelli prima della freccia in `reagenti`, gli altri in `prodotti`.
+// se `prodotti` è nullo ci si ferma alla freccia, che diventa facoltativa
+template <typename CharT>
+static bool parse_equation(std::basic_string_view<CharT> text, std::pmr::vector<Composto>& reagenti,
+                           std::pmr::vector<Composto>* prodotti) {
+    constexpr size_t max_depth = 8;
+    auto* resource = reagenti.get_allocator().resource();
+    auto* side = &reagenti;
+    bool seen_arrow = false;
+    Lexer<CharT> lexer{text};
+    Token tok = lexer.next();
+    auto read_subscript = [&]() -> size_t {
+        if (tok.tipo != TipoToken::Numero && tok.tipo != TipoToken::Pedice) return 1;
+        auto n = static_cast<size_t>(tok.valore);
+        tok = lexer.next();
+        return n;
+    };
+
+    while (true) {
+        size_t quantity = 1;
+        if (tok.tipo == TipoToken::Numero) {
+            quantity = static_cast<size_t>(tok.valore);
+            tok = lexer.next();
+        }
+        std::pmr::vector<ElementQt> elems{resource};
+        // il gruppo aperto, tra parentesi o dopo il punto di un idrato: le parentesi al suo interno
+        // vengono appiattite moltiplicando le quantità degli elementi dalla posizione salvata in `nested`
+        std::optional<GroupElementRef> group{};
+        std::array<size_t, max_depth> nested{};
+        size_t depth = 0;
+        bool hydrate = false;
+        size_t hydrate_quantity = 1;
+        long long charge = 0;
+        auto close_group = [&](size_t size) {
+            if (!group->empty()) elems.push_back(ElementQt{std::in_place_index<1>, std::move(group).value(), size});
+            group.reset();
+        };
+
+        for (bool done = false; !done;) {
+            switch (tok.tipo) {
+            case TipoToken::Elemento: {
+                if (tok.valore < 0) {
+                    error_invalid_element(std::string{tok.simbolo, tok.simbolo[1] == '\0' ? 1u : 2u});
+                    return false;
+                }
+                ElementRef elem = elements[tok.valore];
+                tok = lexer.next();
+                size_t size = read_subscript();
+                if (group.has_value())
+                    group->push_back(SingleElementQt{elem, size});
+                else
+                    elems.push_back(ElementQt{std::in_place_index<0>, elem, size});
+                break;
+            }
+            case TipoToken::ApertaParentesi:
+                if (depth == max_depth) {
+                    error("Troppi gruppi annidati");
+                    return false;
+                }
+                if (!group.has_value()) group.emplace(resource);
+                nested[depth++] = group->size();
+                tok = lexer.next();
+                break;
+            case TipoToken::ChiusaParentesi: {
+                if (depth == 0) {
+                    error("Parentesi chiusa senza gruppo");
+                    return false;
+                }
+                tok = lexer.next();
+                size_t size = read_subscript();
+                size_t start = nested[--depth];
+                if (depth == 0 && !hydrate) {
+                    close_group(size);
+                } else {
+                    for (size_t i = start; i < group->size(); i++) {
+                        long long quantity = 0;
+                        if (!checked_mul(static_cast<long long>((*group)[i].quantity), static_cast<long long>(size),
+                                         quantity)) {
+                            error("Numeri troppo grandi nella reazione");
+                            return false;
+                        }
+                        (*group)[i].quantity = static_cast<size_t>(quantity);
+                    }
+                }
+                break;
+            }
+            case TipoToken::Idrato:
+                if (depth != 0) {
+                    error("Parentesi non chiusa");
+                    return false;
+                }
+                if (hydrate) close_group(hydrate_quantity);
+                tok = lexer.next();
+                hydrate = true;
+                hydrate_quantity = 1;
+                if (tok.tipo == TipoToken::Numero) {
+                    hydrate_quantity = static_cast<size_t>(tok.valore);
+                    tok = lexer.next();
+                }
+                group.emplace(resource);
+                break;
+            case TipoToken::Carica:
+                // Composto tiene la carica in un int
+                if (!checked_add(charge, tok.valore, charge) || charge > std::numeric_limits<int>::max() ||
+                    charge < std::numeric_limits<int>::min()) {
+                    error("Carica troppo grande");
+                    return false;
+                }
+                tok = lexer.next();
+                break;
+            default:
+                done = true;
+                break;
+            }
+        }
+        if (depth != 0) {
+            error("Parentesi non chiusa");
+            return false;
+        }
+        if (hydrate) close_group(hydrate_quantity);
+        if (elems.empty()) {
+            if (tok.tipo == TipoToken::NonValido)
+                error_token(tok);
+            else
+                error_invalid_element({});
+            return false;
+        }
+        side->push_back(Composto{std::move(elems), quantity, static_cast<int>(charge)});
+
+        if (tok.tipo == TipoToken::Fine) break;
+        if (tok.tipo == TipoToken::Piu) {
+            tok = lexer.next();
+        } else if (tok.tipo == TipoToken::Freccia && !seen_arrow) {
+            if (prodotti == nullptr) return true;
+            seen_arrow = true;
+            side = prodotti;
+            tok = lexer.next();
+        } else {
+            error_token(tok);
+            return false;
+        }
+    }
+    if (prodotti != nullptr && !seen_arrow) {
+        error("Formato della reazione non valido");
+        return false;
+    }
+    return true;
+}
+
+template <typename CharT>
+static Verifica verify_text(std::basic_string_view<CharT> equation);
+
+template <typename CharT>
+static Risultato balance_text(std::basic_string_view<CharT> equation) {
+    Reazione r{ReactionArena::create(estimate_arena_size(equation))};
+    if (!parse_equation(equation, r.reagenti, &r.prodotti)) return {.errore = last_error};
+
+    // i coefficienti scritti dall'utente si tengono se conservano elementi e carica, altrimenti si segnala l'errore
+    // insieme alla reazione corretta
+    auto scritto = [](const Composto& composto) { return composto.quantity() != 1; };
+    bool coefficienti_scritti = std::ranges::any_of(r.reagenti, scritto) || std::ranges::any_of(r.prodotti, scritto);
+    if (coefficienti_scritti && verify_text(equation).bilanciata()) return {.reazione = std::move(r)};
+
+    last_error.clear();
+    auto coefficients = solve_coefficients(r);
+    if (!coefficients.has_value()) {
+        if (!last_error.isEmpty()) return {.errore = last_error};
+        return {.reazione = std::move(r), .testo = "Impossibile trovare coefficienti unici per questa reazione\n"};
+    }
+    apply_coefficients(r, coefficients.value());
+    if (coefficienti_scritti) {
+        error("I coefficienti scritti non bilanciano la reazione, quella corretta è: %s",
+              format_equazione(r).toUtf8().constData());
+        return {.errore = last_error};
+    }
+    return {.reazione = std::move(r)};
+}
+
+bool parse_reagents(std::string_view text, std::pmr::vector<Composto>& out) {
+    return parse_equation(text, out, nullptr);
+}
+bool parse_reagents(std::u16string_view text, std::pmr::vector<Composto>& out) {
+    return parse_equation(text, out, nullptr);
+}
+
+Risultato balance_equation(std::string_view equation) {
+    return balance_text(equation);
+}
+Risultato balance_equation(std::u16string_view equation) {
+    return balance_text(equation);
+}
+
+Risultato do_balance(QStringView argument) {
+    return balance_equation(to_u16(argument));
+}
+
+template <typename CharT>
+static Verifica verify_text(std::basic_string_view<CharT> equation) {
+    // una sola passata sul testo senza costruire Composto: i reagenti contano in positivo, i prodotti in negativo
+    constexpr size_t max_atoms = 64;
+    constexpr size_t max_depth = 8;
+    std::array<long long, elements.size()> counts{};
+    std::array<std::pair<int, long long>, max_atoms> atoms{};
+    std::array<size_t, max_depth> group_start{};
+    long long charge = 0;
+    long long side = 1;
+    bool seen_arrow = false;
+
+    Lexer<CharT> lexer{equation};
+    Token tok = lexer.next();
+    // ogni numero è limitato dal lexer, ma i prodotti tra annidamenti, idrati e coefficienti no
+    auto overflow = [&]() -> Verifica {
+        error("Numeri troppo grandi nella reazione");
+        return {.errore = last_error};
+    };
+    auto read_subscript = [&]() -> long long {
+        if (tok.tipo != TipoToken::Numero && tok.tipo != TipoToken::Pedice) return 1;
+        long long n = tok.valore;
+        tok = lexer.next();
+        return n;
+    };
+
+    while (true) {
+        long long coefficient = 1;
+        if (tok.tipo == TipoToken::Numero) {
+            coefficient = tok.valore;
+            tok = lexer.next();
+        }
+        size_t n_atoms = 0;
+        size_t depth = 0;
+        long long term_charge = 0;
+        // gli atomi dopo il punto di un idrato vanno moltiplicati per il numero che lo segue
+        size_t hydrate_start = 0;
+        long long hydrate_multiplier = 1;
+        auto close_hydrate = [&]() {
+            for (size_t i = hydrate_start; i < n_atoms; i++) {
+                if (!checked_mul(atoms[i].second, hydrate_multiplier, atoms[i].second)) return false;
+            }
+            hydrate_multiplier = 1;
+            return true;
+        };
+
+        for (bool done = false; !done;) {
+            switch (tok.tipo) {
+            case TipoToken::Elemento: {
+                if (tok.valore < 0) {
+                    error_invalid_element(std::string{tok.simbolo, tok.simbolo[1] == '\0' ? 1u : 2u});
+                    return {.errore = last_error};
+                }
+                if (n_atoms == max_atoms) {
+                    error("Composto troppo lungo");
+                    return {.errore = last_error};
+                }
+                int idx = static_cast<int>(tok.valore);
+                tok = lexer.next();
+                atoms[n_atoms++] = {idx, read_subscript()};
+                break;
+            }
+            case TipoToken::ApertaParentesi:
+                if (depth == max_depth) {
+                    error("Troppi gruppi annidati");
+                    return {.errore = last_error};
+                }
+                group_start[depth++] = n_atoms;
+                tok = lexer.next();
+                break;
+            case TipoToken::ChiusaParentesi: {
+                if (depth == 0) {
+                    error("Parentesi chiusa senza gruppo");
+                    return {.errore = last_error};
+                }
+                tok = lexer.next();
+                long long multiplier = read_subscript();
+                for (size_t i = group_start[--depth]; i < n_atoms; i++) {
+                    if (!checked_mul(atoms[i].second, multiplier, atoms[i].second)) return overflow();
+                }
+                break;
+            }
+            case TipoToken::Idrato:
+                if (depth != 0) {
+                    error("Parentesi non chiusa");
+                    return {.errore = last_error};
+                }
+                if (!close_hydrate()) return overflow();
+                tok = lexer.next();
+                if (tok.tipo == TipoToken::Numero) {
+                    hydrate_multiplier = tok.valore;
+                    tok = lexer.next();
+                }
+                hydrate_start = n_atoms;
+                break;
+            case TipoToken::Carica:
+                if (!checked_add(term_charge, tok.valore, term_charge)) return overflow();
+                tok = lexer.next();
+                break;
+            default:
+                done = true;
+                break;
+            }
+        }
+        if (depth != 0) {
+            error("Parentesi non chiusa");
+            return {.errore = last_error};
+        }
+        if (!close_hydrate()) return overflow();
+        if (n_atoms == 0 && term_charge == 0) {
+            if (tok.tipo == TipoToken::NonValido)
+                error_token(tok);
+            else
+                error("Manca un composto");
+            return {.errore = last_error};
+        }
+        for (size_t i = 0; i < n_atoms; i++) {
+            long long delta = 0;
+            if (!checked_mul(side * coefficient, atoms[i].second, delta) ||
+                !checked_add(counts[atoms[i].first], delta, counts[atoms[i].first])) {
+                return overflow();
+            }
+        }
+        long long delta = 0;
+        if (!checked_mul(side * coefficient, term_charge, delta) || !checked_add(charge, delta, charge)) {
+            return overflow();
+        }
+
+        if (tok.tipo == TipoToken::Fine) break;
+        if (tok.tipo == TipoToken::Piu) {
+            tok = lexer.next();
+        } else if (tok.tipo == TipoToken::Freccia && !seen_arrow) {
+            seen_arrow = true;
+            side = -1;
+            tok = lexer.next();
+        } else {
+            error_token(tok);
+            return {.errore = last_error};
+        }
+    }
+    if (!seen_arrow) {
+        error("Formato della reazione non valido");
+        return {.errore = last_error};
+    }
+
+    Verifica verifica{.differenza_carica = charge};
+    for (size_t i = 0; i < counts.size(); i++) {
+        if (counts[i] != 0) verifica.elementi.push_back({elements[i], counts[i]});
+    }
+    return verifica;
+}
+
+Verifica verify_balance(std::string_view equation) {
+    return verify_text(equation);
+}
+Verifica verify_balance(std::u16string_view equation) {
+    return verify_text(equation);
+}
+
+QString format_verifica(const Verifica& verifica) {
+    if (!verifica.ok()) return verifica.errore;
+    if (verifica.bilanciata()) return "Bilanciata";
+
+    QString result{"Non bilanciata:"};
+    for (const auto& [elemento, differenza] : verifica.elementi) {
+        result.append(QString::asprintf(" %s %+lld", elemento->name().data(), differenza));
+    }
+    if (verifica.differenza_carica != 0) {
+        result.append(QString::asprintf(" carica %+lld", verifica.differenza_carica));
+    }
     return result;
 }
-QString do_naming(const std::string& argument) {
-    std::string_view formula = argument;
+
+Risultato do_verify(QStringView argument) {
+    auto verifica = verify_balance(to_u16(argument));
+    if (verifica.bilanciata()) return {};
+    return {.errore = format_verifica(verifica)};
+}
+Risultato do_naming(QStringView argument) {
+    QStringView formula = argument;
     TODO();
-    return last_error;
+    return {.errore = last_error};
 }
-QString do_reduction(const std::string& argument) {
+Risultato do_reduction(QStringView argument) {
     TODO();
-    return last_error;
+    return {.errore = last_error};
 }
-QString do_other(const std::string& argument) {
+Risultato do_other(QStringView argument) {
     TODO();
-    return last_error;
+    return {.errore = last_error};
 }
\ No newline at end of file
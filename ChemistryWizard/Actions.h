@@ -2,6 +2,10 @@
 #include <array>
 #include <cctype>
 #include <concepts>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <optional>
 #include <source_location>
 #include <string>
 #include <string_view>
@@ -10,11 +14,13 @@
 #include <vector>
 
 #include <QMessageBox>
+#include <QStringView>
 
 using namespace std::string_view_literals;
 using namespace std::string_literals;
 
-static QString last_error{};
+// un errore per thread: i motori vengono chiamati in parallelo dalla predizione e dal demone
+inline thread_local QString last_error{};
 
 #define TODO()                                                                                                         \
     error("La funzione `%s` non e' ancora stata implementata", std::source_location::current().function_name())
@@ -88,12 +94,38 @@ class Element final : public BaseElement {
     constexpr size_t size_no() const override { return sizeof...(NOs); }
 };
 
+// arena a puntatore crescente per una singola reazione: un solo blocco, liberato tutto insieme.
+// il parser legge i composti in una sola passata e i loro vettori crescono per raddoppi, quindi il blocco viene
+// dimensionato per eccesso (circa il quadruplo degli elementi, vedi estimate_arena_size) invece di riservare
+// una volta sola lo spazio esatto; se la stima non basta si ripiega sull'heap, contando le allocazioni in più.
+class ReactionArena final : public std::pmr::memory_resource {
+    std::byte* m_begin;
+    std::byte* m_current;
+    std::byte* m_end;
+    size_t m_allocations = 1;
+
+    ReactionArena(std::byte* buffer, size_t size) : m_begin(buffer), m_current(buffer), m_end(buffer + size) {}
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* ptr, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    public:
+    struct Deleter {
+        void operator()(ReactionArena* arena) const;
+    };
+    using Ptr = std::unique_ptr<ReactionArena, Deleter>;
+
+    static Ptr create(size_t size);
+    size_t allocations() const { return m_allocations; }
+};
+
 struct SingleElementQt {
     ElementRef element;
     size_t quantity;
 };
 
-using GroupElementRef = std::vector<SingleElementQt>;
+using GroupElementRef = std::pmr::vector<SingleElementQt>;
 
 struct GroupElementQt {
     GroupElementRef group;
@@ -103,17 +135,31 @@ struct GroupElementQt {
 using ElementQt = std::variant<SingleElementQt, GroupElementQt>;
 
 class Composto {
-    std::vector<ElementQt> m_elements{};
+    std::pmr::vector<ElementQt> m_elements{};
     size_t m_quantity;
+    // carica dello ione, 0 per le molecole neutre
+    int m_charge = 0;
 
     public:
-    Composto(std::vector<ElementQt>&& elements, size_t quantity) :
-        m_elements(std::move(elements)), m_quantity(quantity) {}
+    using allocator_type = std::pmr::polymorphic_allocator<>;
+
+    Composto(std::pmr::vector<ElementQt>&& elements, size_t quantity, int charge = 0) :
+        m_elements(std::move(elements)), m_quantity(quantity), m_charge(charge) {}
+    Composto(const Composto&) = default;
+    Composto(Composto&&) = default;
+    Composto(const Composto& other, const allocator_type& alloc) :
+        m_elements(other.m_elements, alloc), m_quantity(other.m_quantity), m_charge(other.m_charge) {}
+    Composto(Composto&& other, const allocator_type& alloc) :
+        m_elements(std::move(other.m_elements), alloc), m_quantity(other.m_quantity), m_charge(other.m_charge) {}
+    Composto& operator=(const Composto&) = default;
+    Composto& operator=(Composto&&) = default;
     auto begin() const { return m_elements.begin(); }
     auto end() const { return m_elements.end(); }
     const ElementQt& operator[](size_t index) const { return m_elements[index]; }
     size_t size() const { return m_elements.size(); }
     size_t quantity() const { return m_quantity; }
+    void set_quantity(size_t quantity) { m_quantity = quantity; }
+    int charge() const { return m_charge; }
     double molecular_mass() const {
         double mass = 0.0;
         for (const auto& elem : m_elements) {
@@ -134,8 +180,44 @@ class Composto {
 };
 
 struct Reazione {
-    std::vector<Composto> reagenti;
-    std::vector<Composto> prodotti;
+    // dichiarata per prima così viene distrutta dopo i vettori che vi allocano
+    ReactionArena::Ptr arena{};
+    std::pmr::vector<Composto> reagenti{};
+    std::pmr::vector<Composto> prodotti{};
+
+    Reazione() = default;
+    explicit Reazione(ReactionArena::Ptr&& arena_) :
+        arena(std::move(arena_)), reagenti(arena.get()), prodotti(arena.get()) {}
+    Reazione(Reazione&&) noexcept = default;
+    Reazione& operator=(Reazione&& other) noexcept {
+        // l'assegnamento membro a membro libererebbe l'arena prima dei vettori che la usano
+        if (this != &other) {
+            std::destroy_at(this);
+            std::construct_at(this, std::move(other));
+        }
+        return *this;
+    }
+
+    // numero di allocazioni fatte per costruire questa reazione
+    size_t allocations() const { return arena ? arena->allocations() : 0; }
+
+    // massa dei reagenti, pesata per la quantità di ciascun composto
+    double molecular_mass() const {
+        double mass = 0.0;
+        for (const auto& reagente : reagenti) {
+            mass += reagente.molecular_mass() * static_cast<double>(reagente.quantity());
+        }
+        return mass;
+    }
+};
+
+// esito di una singola azione: la reazione analizzata, oppure il messaggio d'errore
+struct Risultato {
+    std::optional<Reazione> reazione{};
+    QString errore{};
+    QString testo{};
+
+    bool ok() const { return errore.isEmpty(); }
 };
 
 #define DECLARE_ELEMENT(name, short_name, na, ma, ...)                                                                 \
@@ -351,7 +433,88 @@ tp{"Cf"sv, californio},   tp{"Es"sv, einstenio},    tp{"Fm"sv, fermio},      tp{
 tp{"No"sv, nobelio},      tp{"Lr"sv, laurenzio},
 };
 
-QString do_balance(const std::string& argument);
-QString do_naming(const std::string& argument);
-QString do_reduction(const std::string& argument);
-QString do_other(const std::string& argument);
\ No newline at end of file
+// differenza tra reagenti e prodotti per un elemento, positiva se ce n'è di più nei reagenti
+struct SbilancioElemento {
+    ElementRef elemento;
+    long long differenza;
+};
+
+// esito della verifica di un'equazione con i coefficienti già scritti, es. `2H2 + O2 -> 2H2O`
+// o `2H₂ + O₂ → 2H₂O`. le cariche si scrivono dopo `^` o in apice, es. `Fe^3+`, `Fe³⁺` o `SO4^2-`
+struct Verifica {
+    QString errore{};
+    std::vector<SbilancioElemento> elementi{};
+    long long differenza_carica = 0;
+
+    bool ok() const { return errore.isEmpty(); }
+    bool bilanciata() const { return ok() && elementi.empty() && differenza_carica == 0; }
+};
+
+// a * b e a + b, false in caso di overflow e `out` resta invariato. niente std::abs, non definito su LLONG_MIN
+inline bool checked_mul(long long a, long long b, long long& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    long long result;
+    if (__builtin_mul_overflow(a, b, &result)) return false;
+    out = result;
+    return true;
+#else
+    constexpr long long max = std::numeric_limits<long long>::max();
+    constexpr long long min = std::numeric_limits<long long>::min();
+    if (a > 0 ? (b > 0 ? a > max / b : b < min / a) : (b > 0 ? a < min / b : a != 0 && b < max / a)) return false;
+    out = a * b;
+    return true;
+#endif
+}
+
+inline bool checked_add(long long a, long long b, long long& out) {
+#if defined(__GNUC__) || defined(__clang__)
+    long long result;
+    if (__builtin_add_overflow(a, b, &result)) return false;
+    out = result;
+    return true;
+#else
+    if (b > 0 ? a > std::numeric_limits<long long>::max() - b : a < std::numeric_limits<long long>::min() - b) {
+        return false;
+    }
+    out = a + b;
+    return true;
+#endif
+}
+
+// coefficienti interi positivi minimi che conservano ogni elemento, reagenti prima dei prodotti.
+// vuoto se la reazione non ha una soluzione unica a meno di un fattore, o se i calcoli superano un long long:
+// solo in quest'ultimo caso viene impostato last_error
+std::optional<std::vector<size_t>> solve_coefficients(const Reazione& reazione);
+// assegna ai composti i coefficienti di solve_coefficients, nello stesso ordine
+void apply_coefficients(Reazione& reazione, const std::vector<size_t>& coefficients);
+bool balance_reaction(Reazione& reazione);
+
+// i testi vengono letti direttamente in UTF-8 (CLI, cache) o UTF-16 (QString), senza conversioni.
+
+// analizza i reagenti separati da `+` fino all'eventuale freccia, allocandoli con la risorsa di `out`
+bool parse_reagents(std::string_view text, std::pmr::vector<Composto>& out);
+bool parse_reagents(std::u16string_view text, std::pmr::vector<Composto>& out);
+
+Risultato balance_equation(std::string_view equation);
+Risultato balance_equation(std::u16string_view equation);
+
+Verifica verify_balance(std::string_view equation);
+Verifica verify_balance(std::u16string_view equation);
+QString format_verifica(const Verifica& verifica);
+
+QString format_formula(const Composto& composto, bool with_quantity = true);
+QString format_composto(const Composto& composto);
+QString format_equazione(const Reazione& reazione);
+QString format_risultato(const Risultato& risultato);
+
+inline std::u16string_view to_u16(QStringView view) {
+    return {reinterpret_cast<const char16_t*>(view.utf16()), static_cast<size_t>(view.size())};
+}
+
+Risultato do_balance(QStringView argument);
+Risultato do_naming(QStringView argument);
+Risultato do_reduction(QStringView argument);
+Risultato do_verify(QStringView argument);
+Risultato do_other(QStringView argument);
+
+using callback_t = Risultato (*)(QStringView);
\ No newline at end of file
@@ -1,6 +1,15 @@
 ﻿#include "ChemistryWizardUI.h"
+#include "Actions.h"
+#include "Composition.h"
+#include "Daemon.h"
+#include "Network.h"
+#include "ResultCache.h"
 
 #include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <optional>
 #include <string>
 #include <vector>
 #include <QApplication>
@@ -11,10 +20,107 @@
 #include <windows.h>
 #endif
 
+// esegue `fn` su ogni riga non vuota di stdin; `fn` aggiunge a `output` il testo della riga e restituisce false
+// se la riga non è andata a buon fine. L'uscita viene scritta a blocchi, il codice di ritorno è 1 se qualche
+// riga è fallita
+template <typename Fn>
+static int run_lines(Fn fn) {
+    std::ios::sync_with_stdio(false);
+    std::string line{};
+    std::string output{};
+    int failed = 0;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) continue;
+        if (!fn(line, output)) failed++;
+        output += '\n';
+        if (output.size() > 1 << 16) {
+            std::fwrite(output.data(), 1, output.size(), stdout);
+            output.clear();
+        }
+    }
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    return failed == 0 ? 0 : 1;
+}
+
+// legge un'equazione per riga da stdin e stampa l'esito della verifica, senza avviare la UI
+static int run_verify_cli() {
+    return run_lines([](const std::string& line, std::string& output) {
+        auto verifica = verify_balance(line);
+        if (verifica.bilanciata()) {
+            output += "OK";
+            return true;
+        }
+        output += format_verifica(verifica).toStdString();
+        return false;
+    });
+}
+
+// bilancia un'equazione per riga da stdin; con una cache su disco le righe già viste non vengono rianalizzate
+static int run_balance_cli(const char* cache_path) {
+    std::optional<ResultCache> cache{};
+    if (cache_path != nullptr) cache.emplace(QString::fromLocal8Bit(cache_path));
+    ResultCache* cache_ptr = cache.has_value() && cache->is_open() ? &cache.value() : nullptr;
+    return run_lines([&](const std::string& line, std::string& output) {
+        auto voce = cached_balance(cache_ptr, line);
+        output += voce.testo;
+        return !voce.errore;
+    });
+}
+
+// una composizione percentuale per riga da stdin; per ognuna stampa le formule compatibili separate da ` | `
+static int run_formula_cli() {
+    Campione campione{};
+    return run_lines([&](const std::string& line, std::string& output) {
+        if (!parse_campione(line, campione)) {
+            output += last_error.toStdString();
+            return false;
+        }
+        auto candidati = infer_formula(campione);
+        if (candidati.empty()) {
+            output += "Nessuna formula compatibile";
+            return false;
+        }
+        for (size_t i = 0; i < candidati.size(); i++) {
+            if (i != 0) output += " | ";
+            output += format_candidata(candidati[i]).toStdString();
+        }
+        return true;
+    });
+}
+
+// legge da stdin una rete di reazioni, una per riga, e ne stampa l'analisi
+static int run_network_cli() {
+    std::string text{std::istreambuf_iterator<char>{std::cin}, std::istreambuf_iterator<char>{}};
+    auto analisi = analyze_network(text);
+    auto output = format_analisi(analisi).toStdString();
+    output += '\n';
+    std::fwrite(output.data(), 1, output.size(), stdout);
+    return analisi.ok() ? 0 : 1;
+}
+
 int main(int argc, char* argv[]) {
 #ifdef _WIN32
     SetConsoleOutputCP(GetACP());
 #endif
+    if (argc > 1 && std::strcmp(argv[1], "--verify") == 0) return run_verify_cli();
+    if (argc > 1 && std::strcmp(argv[1], "--network") == 0) return run_network_cli();
+    if (argc > 1 && std::strcmp(argv[1], "--formula") == 0) return run_formula_cli();
+    if (argc > 1 && std::strcmp(argv[1], "--daemon") == 0) {
+        bool with_cache = argc > 3 && std::strcmp(argv[3], "--cache") == 0;
+        if (argc < 3 || (with_cache && argc < 5)) {
+            std::fputs("uso: --daemon <socket> [--cache <file>]\n", stderr);
+            return 2;
+        }
+        return run_daemon(argv[2], with_cache ? argv[4] : nullptr);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--balance") == 0) {
+        bool with_cache = argc > 2 && std::strcmp(argv[2], "--cache") == 0;
+        if (with_cache && argc < 4) {
+            std::fputs("uso: --balance [--cache <file>]\n", stderr);
+            return 2;
+        }
+        return run_balance_cli(with_cache ? argv[3] : nullptr);
+    }
     QApplication a(argc, argv);
     ChemistryWizardUI w;
     w.show();
@@ -1,5 +1,8 @@
 ﻿#pragma once
 #include "Actions.h"
+#include "Composition.h"
+#include "Network.h"
+#include "Prediction.h"
 #include <type_traits>
 #include <cstdlib>
 #include <QString>
@@ -20,19 +23,27 @@ enum class Azione {
     Nomenclatura,
     Bilanciamento,
     Riduzione,
+    Verifica,
+    Predizione,
+    Rete,
+    Formula,
     Altro,
 
     __SIZE__
 };
 
-using callback_t = QString (*)(const std::string&);
-
 struct NamedCallback {
     std::string name;
     callback_t callback;
+    // la callback riceve tutto il testo invece di una riga alla volta
+    bool whole_input = false;
 };
 
 static inline NamedCallback callbacks[from_enum(Azione::__SIZE__)] = {{"Nomenclatura"s, &do_naming},
                                                                       {"Bilanciamento"s, &do_balance},
                                                                       {"Riduzione"s, &do_reduction},
+                                                                      {"Verifica"s, &do_verify},
+                                                                      {"Predizione"s, &do_predict},
+                                                                      {"Rete di reazioni"s, &do_network, true},
+                                                                      {"Formula da composizione"s, &do_formula},
                                                                       {"Altro..."s, &do_other}};
\ No newline at end of file
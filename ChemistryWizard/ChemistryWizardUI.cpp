@@ -2,9 +2,12 @@
 #include "ui_ChemistryWizard.h"
 
 #include "ChemistryWizard.h"
+#include "ResultModel.h"
 
+#include <QComboBox>
 #include <QPushButton>
 #include <QTextEdit>
+#include <QTreeView>
 #include <QVBoxLayout>
 #include <QDockWidget>
 
@@ -12,10 +15,27 @@ ChemistryWizardUI::ChemistryWizardUI(QWidget* parent) : QMainWindow(parent), ui(
     ui->setupUi(this);
 
     auto input = new QTextEdit(this);
-    auto output = new QTextEdit(this);
-    output->setReadOnly(true);
-    output->setSizeAdjustPolicy(QAbstractScrollArea::SizeAdjustPolicy::AdjustToContents);
     input->setAcceptRichText(false);
+
+    auto model = new ResultModel(this);
+    auto proxy = new ResultFilterModel(this);
+    proxy->setSourceModel(model);
+
+    // la view disegna solo le righe visibili, l'altezza uniforme evita di misurarle tutte
+    auto output = new QTreeView(this);
+    output->setModel(proxy);
+    output->setUniformRowHeights(true);
+    output->setSortingEnabled(true);
+    output->sortByColumn(-1, Qt::AscendingOrder);
+
+    auto filter = new QComboBox(this);
+    filter->addItem("Tutti i risultati", from_enum(ResultFilterModel::Filtro::Tutti));
+    filter->addItem("Solo validi", from_enum(ResultFilterModel::Filtro::Validi));
+    filter->addItem("Solo errori", from_enum(ResultFilterModel::Filtro::Errori));
+    QObject::connect(filter, &QComboBox::currentIndexChanged, this, [filter, proxy](int index) {
+        proxy->set_filter(to_enum<ResultFilterModel::Filtro>(filter->itemData(index).toInt()));
+    });
+
     auto widget = new QWidget(centralWidget());
     auto layout = new QVBoxLayout(widget);
     widget->setLayout(layout);
@@ -29,12 +49,51 @@ ChemistryWizardUI::ChemistryWizardUI(QWidget* parent) : QMainWindow(parent), ui(
         btn->setFont(font);
         btn->setText(QString::fromStdString(named_callback.name));
         btn->adjustSize();
-        QObject::connect(btn, &QPushButton::clicked, this, [input, output, named_callback]() {
-            output->clear();
-            output->insertPlainText(named_callback.callback(input->toPlainText().toStdString()));
+        QObject::connect(btn, &QPushButton::clicked, this, [this, input, model, named_callback]() {
+            // la valutazione precedente viene solo fermata: attenderla bloccherebbe la UI finché non finisce la riga
+            // corrente, e le sue righe in arrivo vengono scartate dal modello perché di una generazione vecchia
+            for (auto& valutazione : m_valutazioni) valutazione.thread.request_stop();
+            std::erase_if(m_valutazioni, [](const Valutazione& valutazione) { return valutazione.finita->load(); });
+            uint64_t generazione = model->reset();
+            auto text = input->toPlainText();
+            auto& valutazione = m_valutazioni.emplace_back();
+            // le righe arrivano al modello a blocchi, così la view si riempie mentre la valutazione prosegue
+            valutazione.thread = std::jthread{[model, generazione, named_callback, text,
+                                               finita = valutazione.finita.get()](std::stop_token stop) {
+                std::vector<RigaRisultato> righe{};
+                auto flush = [&]() {
+                    QMetaObject::invokeMethod(
+                        model,
+                        [model, generazione, righe = std::move(righe)]() mutable {
+                            model->append_results(generazione, std::move(righe));
+                        },
+                        Qt::QueuedConnection);
+                    righe = {};
+                };
+                auto evaluate = [&]() {
+                    if (named_callback.whole_input) {
+                        auto trimmed = text.trimmed();
+                        righe.push_back(make_riga(trimmed, named_callback.callback(trimmed)));
+                        return;
+                    }
+                    // una riga di input per reazione
+                    constexpr size_t righe_per_blocco = 4096;
+                    for (const auto& line : text.split('\n', Qt::SkipEmptyParts)) {
+                        if (stop.stop_requested()) return;
+                        auto trimmed = line.trimmed();
+                        if (trimmed.isEmpty()) continue;
+                        righe.push_back(make_riga(trimmed, named_callback.callback(trimmed)));
+                        if (righe.size() == righe_per_blocco) flush();
+                    }
+                };
+                evaluate();
+                if (!stop.stop_requested()) flush();
+                finita->store(true);
+            }};
         });
         layout->addWidget(btn);
     }
+    layout->addWidget(filter);
     layout->addWidget(output);
     widget->adjustSize();
 }
@@ -1,4 +1,9 @@
 #pragma once
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <QMainWindow>
 
 QT_BEGIN_NAMESPACE
@@ -16,4 +21,12 @@ class ChemistryWizardUI : public QMainWindow {
 
     private:
     Ui::ChemistryWizardUI* ui;
+    // valutazione delle righe fuori dal thread della UI
+    struct Valutazione {
+        // impostato dal thread quando ha finito, così lo si può rimuovere senza bloccare la UI
+        std::unique_ptr<std::atomic<bool>> finita = std::make_unique<std::atomic<bool>>(false);
+        std::jthread thread{};
+    };
+    // l'ultima è quella corrente, le precedenti sono fermate ma ancora in corso: le attende solo il distruttore
+    std::vector<Valutazione> m_valutazioni{};
 };
\ No newline at end of file
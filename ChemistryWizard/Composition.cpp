@@ -0,0 +1,255 @@
+#include "Composition.h"
+#include "Lexer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <set>
+
+// fattore massimo tra la formula empirica e i rapporti molari normalizzati sull'elemento meno abbondante
+static constexpr size_t max_multiplier = 12;
+static constexpr size_t max_atoms = 60;
+// scarto relativo ammesso tra la massa molare data e quella della formula molecolare
+static constexpr double tolleranza_massa = 0.02;
+// la somma delle percentuali viene riportata a 100, ma solo se non se ne discosta troppo
+static constexpr double tolleranza_somma = 5.0;
+
+double FormulaCandidata::massa_empirica() const {
+    double mass = 0.0;
+    for (const auto& [elemento, quantity] : empirica) mass += elemento->ma() * static_cast<double>(quantity);
+    return mass;
+}
+
+template <typename CharT>
+static bool parse_text(std::basic_string_view<CharT> text, Campione& out) {
+    size_t pos = 0;
+    auto at = [&](size_t i) -> char32_t { return i < text.size() ? static_cast<char32_t>(text[i]) : U'\0'; };
+    auto is_digit = [](char32_t c) { return c >= U'0' && c <= U'9'; };
+    auto skip = [&](std::u32string_view separators) {
+        while (pos < text.size() && separators.find(at(pos)) != std::u32string_view::npos) pos++;
+    };
+    // numero decimale con il punto o la virgola: una virgola seguita da una cifra non separa gli elementi
+    auto read_number = [&](double& value) {
+        if (!is_digit(at(pos))) return false;
+        value = 0.0;
+        while (is_digit(at(pos))) value = value * 10 + static_cast<double>(at(pos++) - U'0');
+        if ((at(pos) == U'.' || at(pos) == U',') && is_digit(at(pos + 1))) {
+            pos++;
+            for (double scale = 0.1; is_digit(at(pos)); scale /= 10) {
+                value += scale * static_cast<double>(at(pos++) - U'0');
+            }
+        }
+        return true;
+    };
+
+    out.percentuali.clear();
+    out.massa_molare.reset();
+    while (true) {
+        skip(U" \t\r\n,;");
+        if (pos >= text.size()) break;
+        char upper = at(pos) >= U'A' && at(pos) <= U'Z' ? static_cast<char>(at(pos)) : '\0';
+        if (upper == '\0') {
+            error("Composizione non valida alla posizione %llu", static_cast<unsigned long long>(pos + 1));
+            return false;
+        }
+        pos++;
+        char lower = '\0';
+        if (at(pos) >= U'a' && at(pos) <= U'z') lower = static_cast<char>(at(pos++));
+        std::string symbol = lower == '\0' ? std::string{upper} : std::string{upper, lower};
+
+        skip(U" \t:=");
+        double value = 0.0;
+        if (!read_number(value)) {
+            error("Manca il valore di %s", symbol.c_str());
+            return false;
+        }
+        skip(U" \t");
+        if (at(pos) == U'%') pos++;
+
+        // `M` non è un elemento: è la massa molare
+        if (symbol == "M") {
+            out.massa_molare = value;
+            continue;
+        }
+        int idx = symbol_index(upper, lower);
+        if (idx < 0) {
+            error_invalid_element(symbol);
+            return false;
+        }
+        auto same = [&](const auto& p) { return p.elemento->na() == elements[idx]->na(); };
+        if (std::ranges::any_of(out.percentuali, same)) {
+            error("Elemento %s ripetuto", symbol.c_str());
+            return false;
+        }
+        out.percentuali.push_back({elements[idx], value});
+    }
+    if (out.percentuali.empty()) {
+        error("Nessun elemento nella composizione");
+        return false;
+    }
+    return true;
+}
+
+bool parse_campione(std::string_view text, Campione& out) {
+    return parse_text(text, out);
+}
+bool parse_campione(std::u16string_view text, Campione& out) {
+    return parse_text(text, out);
+}
+
+// ordine di Hill: carbonio, idrogeno e poi gli altri per simbolo; senza carbonio tutti per simbolo.
+// SingleElementQt contiene un riferimento e non si può riordinare, quindi si ordinano gli indici
+static std::vector<size_t> hill_order(const std::vector<PercentualeElemento>& dati) {
+    bool has_carbon = std::ranges::any_of(dati, [](const auto& p) { return p.elemento->name() == "C"sv; });
+    auto key = [&](size_t i) {
+        auto name = dati[i].elemento->name();
+        int rank = 2;
+        if (has_carbon && name == "C"sv) rank = 0;
+        if (has_carbon && name == "H"sv) rank = 1;
+        return std::pair{rank, name};
+    };
+    std::vector<size_t> ordine(dati.size());
+    std::iota(ordine.begin(), ordine.end(), size_t{0});
+    std::ranges::sort(ordine, {}, key);
+    return ordine;
+}
+
+std::vector<FormulaCandidata> infer_formula(const Campione& campione, double tolleranza, size_t max_candidati) {
+    const auto& dati = campione.percentuali;
+    const size_t n = dati.size();
+    double somma = 0.0;
+    for (const auto& p : dati) somma += p.percentuale;
+    if (std::abs(somma - 100.0) > tolleranza_somma) {
+        error("La somma delle percentuali e' %.1f, troppo lontana da 100", somma);
+        return {};
+    }
+
+    // rapporti molari rispetto all'elemento meno abbondante
+    std::vector<double> percentuali(n);
+    std::vector<double> rapporti(n);
+    for (size_t i = 0; i < n; i++) {
+        percentuali[i] = dati[i].percentuale * 100.0 / somma;
+        rapporti[i] = percentuali[i] / dati[i].elemento->ma();
+    }
+    const size_t riferimento = static_cast<size_t>(std::ranges::min_element(rapporti) - rapporti.begin());
+    const double min_moli = rapporti[riferimento];
+    if (min_moli <= 0.0) return {};
+    for (auto& r : rapporti) r /= min_moli;
+
+    const auto ordine = hill_order(dati);
+    std::vector<FormulaCandidata> candidati{};
+    std::vector<size_t> atomi(n, 0);
+    // moltiplicatori vicini possono arrivare alle stesse quantità, es. 2 è sopra 1 e sotto 2 * 1
+    std::set<std::vector<size_t>> visti{};
+    auto evaluate = [&]() {
+        size_t g = 0;
+        for (size_t a : atomi) g = std::gcd(g, a);
+        // con un divisore comune la stessa formula è già stata trovata con un moltiplicatore più piccolo
+        if (g != 1 || !visti.insert(atomi).second) return;
+        double mass = 0.0;
+        for (size_t i = 0; i < n; i++) mass += dati[i].elemento->ma() * static_cast<double>(atomi[i]);
+        double errore = 0.0;
+        for (size_t i = 0; i < n; i++) {
+            double calcolata = 100.0 * dati[i].elemento->ma() * static_cast<double>(atomi[i]) / mass;
+            errore = std::max(errore, std::abs(calcolata - percentuali[i]));
+        }
+        if (errore > tolleranza) return;
+
+        FormulaCandidata candidata{.errore = errore};
+        if (campione.massa_molare.has_value()) {
+            double m = campione.massa_molare.value();
+            candidata.fattore = static_cast<size_t>(std::max(1.0, std::round(m / mass)));
+            candidata.errore_massa = std::abs(static_cast<double>(candidata.fattore) * mass - m) / m;
+            if (candidata.errore_massa > tolleranza_massa) return;
+        }
+        for (size_t i : ordine) candidata.empirica.push_back({dati[i].elemento, atomi[i]});
+        candidati.push_back(std::move(candidata));
+    };
+
+    // per ogni moltiplicatore ogni elemento prova l'intero sotto e sopra il proprio rapporto; un ramo viene tagliato
+    // quando lo scarto relativo del rapporto supera l'incertezza che la tolleranza lascia sulle due percentuali
+    for (size_t k = 1; k <= max_multiplier; k++) {
+        auto branch = [&](auto& self, size_t i) -> void {
+            if (i == n) {
+                evaluate();
+                return;
+            }
+            double target = static_cast<double>(k) * rapporti[i];
+            double lo = std::floor(target);
+            double hi = std::max(std::ceil(target), lo + 1.0);
+            for (double v : {lo, hi}) {
+                if (v < 1.0 || v > static_cast<double>(max_atoms)) continue;
+                double incertezza = 2 * tolleranza * (1.0 / percentuali[i] + 1.0 / percentuali[riferimento]);
+                if (std::abs(v - target) / target > incertezza) continue;
+                atomi[i] = static_cast<size_t>(v);
+                self(self, i + 1);
+            }
+        };
+        branch(branch, 0);
+    }
+
+    // a parità di scarto si preferisce la formula più semplice: ogni atomo pesa un centesimo di punto
+    auto score = [](const FormulaCandidata& c) {
+        size_t n_atomi = 0;
+        for (const auto& a : c.empirica) n_atomi += a.quantity;
+        return c.errore + 0.01 * static_cast<double>(n_atomi) + c.errore_massa;
+    };
+    std::ranges::sort(candidati, {}, score);
+    if (candidati.size() > max_candidati) candidati.resize(max_candidati);
+    return candidati;
+}
+
+static QString format_atomi(const std::vector<SingleElementQt>& atomi, size_t fattore) {
+    QString text{};
+    for (const auto& [elemento, quantity] : atomi) {
+        text.append(QString::fromUtf8(elemento->name().data(), static_cast<qsizetype>(elemento->name().size())));
+        if (quantity * fattore != 1) {
+            text.append(QString::asprintf("%llu", static_cast<unsigned long long>(quantity * fattore)));
+        }
+    }
+    return text;
+}
+
+QString format_candidata(const FormulaCandidata& candidata) {
+    QString text = format_atomi(candidata.empirica, 1);
+    if (candidata.fattore > 1) {
+        text.append(" x ");
+        text.append(QString::asprintf("%llu", static_cast<unsigned long long>(candidata.fattore)));
+        text.append(" = ");
+        text.append(format_atomi(candidata.empirica, candidata.fattore));
+    }
+    text.append(QString::asprintf(" (scarto %.2f punti", candidata.errore));
+    if (candidata.errore_massa > 0.0 || candidata.fattore > 1) {
+        double massa = candidata.massa_empirica() * static_cast<double>(candidata.fattore);
+        text.append(QString::asprintf(", massa %.2f", massa));
+    }
+    text.append(")");
+    return text;
+}
+
+Risultato do_formula(QStringView argument) {
+    Campione campione{};
+    if (!parse_campione(to_u16(argument), campione)) return {.errore = last_error};
+    last_error.clear();
+    auto candidati = infer_formula(campione);
+    if (candidati.empty()) {
+        if (last_error.isEmpty()) error("Nessuna formula compatibile con questa composizione");
+        return {.errore = last_error};
+    }
+
+    // la formula migliore diventa un composto, così la vista ne mostra la massa molare
+    const auto& migliore = candidati.front();
+    std::pmr::vector<ElementQt> elems{};
+    for (const auto& [elemento, quantity] : migliore.empirica) {
+        elems.push_back(ElementQt{std::in_place_index<0>, elemento, quantity * migliore.fattore});
+    }
+    Reazione reazione{};
+    reazione.reagenti.push_back(Composto{std::move(elems), 1});
+
+    QString testo{"Formule compatibili:\n"};
+    for (const auto& candidata : candidati) {
+        testo.append(format_candidata(candidata));
+        testo.append("\n");
+    }
+    return {.reazione = std::move(reazione), .testo = testo};
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Actions.h"
+
+struct PercentualeElemento {
+    ElementRef elemento;
+    double percentuale;
+};
+
+// composizione percentuale in massa di un campione, es. `C 40.0%, H 6.7%, O 53.3%; M = 180.16`
+struct Campione {
+    std::vector<PercentualeElemento> percentuali{};
+    std::optional<double> massa_molare{};
+};
+
+struct FormulaCandidata {
+    // formula empirica in ordine di Hill (C, H, poi in ordine alfabetico)
+    std::vector<SingleElementQt> empirica{};
+    // quante volte la formula empirica sta in quella molecolare, 1 se la massa molare non è nota
+    size_t fattore = 1;
+    // massimo scarto dalle percentuali date, in punti percentuali
+    double errore = 0.0;
+    // scarto relativo dalla massa molare data, 0 se non è nota
+    double errore_massa = 0.0;
+
+    double massa_empirica() const;
+};
+
+bool parse_campione(std::string_view text, Campione& out);
+bool parse_campione(std::u16string_view text, Campione& out);
+
+// formule con pochi atomi le cui percentuali distano al più `tolleranza` punti da quelle del campione,
+// dalla più probabile. Con la massa molare si cerca anche la formula molecolare.
+// vuoto, con last_error impostato, se la somma delle percentuali è troppo lontana da 100
+std::vector<FormulaCandidata> infer_formula(const Campione& campione, double tolleranza = 0.5,
+                                            size_t max_candidati = 5);
+QString format_candidata(const FormulaCandidata& candidata);
+
+Risultato do_formula(QStringView argument);
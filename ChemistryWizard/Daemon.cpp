@@ -0,0 +1,485 @@
+#include "Daemon.h"
+#include "Actions.h"
+#include "Parallel.h"
+#include "ResultCache.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+
+int run_daemon(const char* path, const char* cache_path) {
+    std::fputs("La modalita' demone usa i socket Unix e non e' disponibile su Windows\n", stderr);
+    return 1;
+}
+
+#else
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+volatile std::sig_atomic_t stop_requested = 0;
+// self-pipe: il gestore scrive un byte, così un segnale arrivato tra il controllo di stop_requested e poll
+// sveglia comunque il ciclo invece di restare in attesa fino alla prossima richiesta
+int signal_pipe[2] = {-1, -1};
+
+void on_signal(int) {
+    int saved_errno = errno;
+    stop_requested = 1;
+    char byte = 1;
+    [[maybe_unused]] ssize_t scritti = write(signal_pipe[1], &byte, 1);
+    errno = saved_errno;
+}
+
+// oltre questa quantità di risposte non ancora spedite si smette di leggere dal client finché non le riceve
+constexpr size_t max_pending_output = 8u << 20;
+// lo stesso per le richieste ricevute ma non ancora estratte; ci deve stare almeno un messaggio completo
+constexpr size_t max_pending_input = 4u << 20;
+static_assert(max_pending_input > header_size + max_message_size);
+// richieste raccolte al massimo in un solo giro del ciclo, da tutti i client insieme
+constexpr size_t max_batch = 4096;
+// voci di ciascuna delle due generazioni della cache in memoria
+constexpr size_t max_cache_entries = 1u << 16;
+// codice interno delle richieste malformate, il cui testo è il messaggio d'errore
+constexpr uint16_t codice_protocollo = 0;
+
+struct Client {
+    int fd;
+    std::string in{};
+    std::string out{};
+    size_t out_pos = 0;
+    // dopo la chiusura del client o un errore di protocollo si spediscono le risposte già pronte e poi si chiude
+    bool closing = false;
+};
+
+struct Richiesta {
+    Client* client;
+    uint32_t id;
+    uint16_t codice;
+    std::string testo;
+};
+
+struct Statistiche {
+    uint64_t richieste = 0;
+    uint64_t batch = 0;
+    uint64_t batch_max = 0;
+    uint64_t hit_memoria = 0;
+    uint64_t hit_file = 0;
+    uint64_t calcolate = 0;
+    uint64_t errori = 0;
+    uint64_t connessioni = 0;
+    std::chrono::nanoseconds tempo_calcolo{};
+    std::chrono::steady_clock::time_point avvio = std::chrono::steady_clock::now();
+};
+
+// cache in memoria a due generazioni: quando quella recente è piena diventa la vecchia e la vecchia si scarta,
+// così le voci usate di continuo restano calde senza tenere un ordine LRU per ogni accesso
+class CacheMemoria {
+    std::unordered_map<std::string, VoceCache> m_recenti{};
+    std::unordered_map<std::string, VoceCache> m_vecchie{};
+
+    public:
+    const VoceCache* find(const std::string& key) {
+        if (auto it = m_recenti.find(key); it != m_recenti.end()) return &it->second;
+        auto it = m_vecchie.find(key);
+        if (it == m_vecchie.end()) return nullptr;
+        return &insert(key, std::move(it->second));
+    }
+    const VoceCache& insert(const std::string& key, VoceCache voce) {
+        if (m_recenti.size() >= max_cache_entries) {
+            m_vecchie = std::move(m_recenti);
+            m_recenti = {};
+            m_recenti.reserve(max_cache_entries);
+        }
+        return m_recenti.insert_or_assign(key, std::move(voce)).first->second;
+    }
+    size_t size() const { return m_recenti.size() + m_vecchie.size(); }
+};
+
+void put_u16(std::string& out, uint16_t value) {
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>(value >> 8);
+}
+
+void put_u32(std::string& out, uint32_t value) {
+    for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>((value >> shift) & 0xFF);
+}
+
+uint32_t get_u32(const char* data) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; i--) value = (value << 8) | static_cast<unsigned char>(data[i]);
+    return value;
+}
+
+uint16_t get_u16(const char* data) {
+    return static_cast<uint16_t>(static_cast<unsigned char>(data[0]) | (static_cast<unsigned char>(data[1]) << 8));
+}
+
+void append_response(Client& client, uint32_t id, Esito esito, std::string_view testo) {
+    put_u32(client.out, static_cast<uint32_t>(testo.size()));
+    put_u32(client.out, id);
+    put_u16(client.out, static_cast<uint16_t>(esito));
+    put_u16(client.out, 0);
+    client.out += testo;
+}
+
+// Nomenclatura e Riduzione non sono ancora implementate nei motori, quindi vengono rifiutate come le sconosciute
+bool valid_operation(uint16_t codice) {
+    switch (static_cast<Operazione>(codice)) {
+    case Operazione::Bilanciamento:
+    case Operazione::Massa:
+    case Operazione::Statistiche:
+        return true;
+    default:
+        return false;
+    }
+}
+
+VoceCache compute_mass(const std::string& testo) {
+    std::pmr::vector<Composto> composti{};
+    VoceCache voce{};
+    if (!parse_reagents(testo, composti)) {
+        voce.errore = true;
+        voce.testo = last_error.toStdString();
+        return voce;
+    }
+    double mass = 0.0;
+    for (const auto& composto : composti) mass += composto.molecular_mass() * static_cast<double>(composto.quantity());
+    char buffer[32];
+    int size = std::snprintf(buffer, sizeof(buffer), "%.3f", mass);
+    voce.testo.assign(buffer, static_cast<size_t>(size));
+    return voce;
+}
+
+// i motori non condividono stato tra una chiamata e l'altra (l'errore è per thread), quindi possono girare
+// in parallelo
+VoceCache compute(uint16_t codice, const std::string& testo) {
+    switch (static_cast<Operazione>(codice)) {
+    case Operazione::Bilanciamento:
+        return cached_balance(nullptr, testo);
+    case Operazione::Massa:
+        return compute_mass(testo);
+    default:
+        return {.testo = "Operazione non valida", .errore = true};
+    }
+}
+
+std::string format_statistiche(const Statistiche& stats, size_t client_aperti, size_t voci_memoria) {
+    using namespace std::chrono;
+    auto uptime = duration_cast<seconds>(steady_clock::now() - stats.avvio).count();
+    double medio = 0.0;
+    if (stats.calcolate > 0) {
+        double micro = static_cast<double>(duration_cast<nanoseconds>(stats.tempo_calcolo).count()) / 1000.0;
+        medio = micro / static_cast<double>(stats.calcolate);
+    }
+    auto u = [](uint64_t value) { return static_cast<unsigned long long>(value); };
+    char buffer[512];
+    int size = std::snprintf(buffer, sizeof(buffer),
+                             "richieste %llu\nbatch %llu\nbatch_max %llu\nhit_memoria %llu\nhit_file %llu\n"
+                             "calcolate %llu\nerrori %llu\nconnessioni_totali %llu\nconnessioni_aperte %zu\n"
+                             "voci_memoria %zu\ncalcolo_medio_us %.2f\nuptime_s %lld\n",
+                             u(stats.richieste), u(stats.batch), u(stats.batch_max), u(stats.hit_memoria),
+                             u(stats.hit_file), u(stats.calcolate), u(stats.errori), u(stats.connessioni),
+                             client_aperti, voci_memoria, medio, static_cast<long long>(uptime));
+    return {buffer, static_cast<size_t>(size)};
+}
+
+// estrae le richieste complete dal buffer del client; false se il client ha violato il protocollo
+bool read_requests(Client& client, std::vector<Richiesta>& batch) {
+    size_t pos = 0;
+    while (batch.size() < max_batch && client.in.size() - pos >= header_size) {
+        const char* header = client.in.data() + pos;
+        uint32_t lunghezza = get_u32(header);
+        uint32_t id = get_u32(header + 4);
+        uint16_t codice = get_u16(header + 8);
+        if (lunghezza > max_message_size || !valid_operation(codice)) {
+            // la risposta d'errore entra nel batch per restare in ordine con quelle delle richieste precedenti;
+            // il resto del buffer non è più interpretabile
+            batch.push_back({&client, id, codice_protocollo,
+                             lunghezza > max_message_size ? "Messaggio troppo lungo" : "Operazione non valida"});
+            client.in.clear();
+            return false;
+        }
+        if (client.in.size() - pos - header_size < lunghezza) break;
+        batch.push_back({&client, id, codice, client.in.substr(pos + header_size, lunghezza)});
+        pos += header_size + lunghezza;
+    }
+    client.in.erase(0, pos);
+    return true;
+}
+
+// richieste già complete rimaste nel buffer perché il batch precedente era pieno
+bool has_request(const Client& client) {
+    if (client.in.size() < header_size) return false;
+    uint32_t lunghezza = get_u32(client.in.data());
+    return lunghezza > max_message_size || client.in.size() - header_size >= lunghezza;
+}
+
+int open_socket(const char* path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path)) {
+        std::fprintf(stderr, "Percorso del socket troppo lungo: %s\n", path);
+        return -1;
+    }
+    std::strcpy(addr.sun_path, path);
+
+    // un socket rimasto da un'esecuzione precedente si può rimuovere, qualunque altro file no. Se qualcuno accetta
+    // ancora connessioni il socket è di un demone attivo e va lasciato al suo posto
+    struct stat st{};
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::fprintf(stderr, "%s esiste gia' e non e' un socket\n", path);
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        bool refused = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 &&
+                       errno == ECONNREFUSED;
+        if (probe >= 0) close(probe);
+        if (!refused) {
+            std::fprintf(stderr, "%s e' gia' in uso\n", path);
+            return -1;
+        }
+        unlink(path);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+        std::fprintf(stderr, "Impossibile aprire il socket %s: %s\n", path, std::strerror(errno));
+        if (fd >= 0) close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+}
+
+int run_daemon(const char* path, const char* cache_path) {
+    std::optional<ResultCache> cache_file{};
+    if (cache_path != nullptr) cache_file.emplace(QString::fromLocal8Bit(cache_path));
+    ResultCache* persistent = cache_file.has_value() && cache_file->is_open() ? &cache_file.value() : nullptr;
+
+    int listener = open_socket(path);
+    if (listener < 0) return 1;
+
+    stop_requested = 0;
+    if (pipe(signal_pipe) != 0) {
+        std::fprintf(stderr, "pipe: %s\n", std::strerror(errno));
+        close(listener);
+        unlink(path);
+        return 1;
+    }
+    for (int fd : signal_pipe) {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction action{};
+    action.sa_handler = &on_signal;
+    sigemptyset(&action.sa_mask);
+    // i gestori precedenti vengono ripristinati all'uscita, prima di chiudere la pipe su cui scrive on_signal
+    struct sigaction previous_int{};
+    struct sigaction previous_term{};
+    sigaction(SIGINT, &action, &previous_int);
+    sigaction(SIGTERM, &action, &previous_term);
+    std::signal(SIGPIPE, SIG_IGN);
+    std::fprintf(stderr, "In ascolto su %s\n", path);
+
+    std::vector<std::unique_ptr<Client>> clients{};
+    std::vector<pollfd> fds{};
+    std::vector<Richiesta> batch{};
+    CacheMemoria memoria{};
+    Statistiche stats{};
+    // i thread che calcolano i batch vengono creati una volta sola, per tutta la vita del demone
+    WorkerPool pool{};
+    char buffer[1 << 16];
+    // fds contiene prima il listener e la pipe dei segnali, poi un elemento per client
+    constexpr size_t first_client = 2;
+
+    while (stop_requested == 0) {
+        fds.clear();
+        fds.push_back({listener, POLLIN, 0});
+        fds.push_back({signal_pipe[0], POLLIN, 0});
+        for (const auto& client : clients) {
+            short events = 0;
+            if (!client->closing && client->out.size() - client->out_pos < max_pending_output &&
+                client->in.size() < max_pending_input) {
+                events |= POLLIN;
+            }
+            if (client->out_pos < client->out.size()) events |= POLLOUT;
+            fds.push_back({client->fd, events, 0});
+        }
+        int timeout = std::ranges::any_of(clients, [](const auto& client) { return has_request(*client); }) ? 0 : -1;
+        if (poll(fds.data(), fds.size(), timeout) < 0) {
+            if (errno == EINTR) continue;
+            std::fprintf(stderr, "poll: %s\n", std::strerror(errno));
+            break;
+        }
+        // la pipe riceve dati solo dal gestore dei segnali
+        if (fds[1].revents & POLLIN) break;
+
+        if (fds[0].revents & POLLIN) {
+            while (true) {
+                int fd = accept(listener, nullptr, nullptr);
+                if (fd < 0) break;
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+                clients.push_back(std::make_unique<Client>(Client{fd}));
+                stats.connessioni++;
+            }
+        }
+
+        // tutte le richieste arrivate insieme, da qualunque client, formano un solo batch
+        batch.clear();
+        for (size_t i = first_client; i < fds.size(); i++) {
+            Client& client = *clients[i - first_client];
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                while (client.in.size() < max_pending_input) {
+                    ssize_t letti = read(client.fd, buffer, sizeof(buffer));
+                    if (letti > 0) {
+                        client.in.append(buffer, static_cast<size_t>(letti));
+                        if (static_cast<size_t>(letti) < sizeof(buffer)) break;
+                    } else {
+                        if (letti == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                            client.closing = true;
+                        }
+                        break;
+                    }
+                }
+            }
+            if (!read_requests(client, batch)) client.closing = true;
+        }
+
+        if (!batch.empty()) {
+            stats.batch++;
+            stats.batch_max = std::max<uint64_t>(stats.batch_max, batch.size());
+            stats.richieste += batch.size();
+
+            // prima le cache; le richieste uguali nello stesso batch vengono calcolate una volta sola.
+            // le voci trovate si copiano, perché inserimenti successivi possono scartare la generazione vecchia
+            std::vector<const VoceCache*> risposte(batch.size(), nullptr);
+            std::vector<std::string> chiavi(batch.size());
+            std::vector<VoceCache> da_cache{};
+            std::unordered_map<std::string_view, size_t> da_calcolare{};
+            std::vector<size_t> calcolo_di(batch.size(), SIZE_MAX);
+            std::vector<size_t> primi{};
+            da_cache.reserve(batch.size());
+            for (size_t i = 0; i < batch.size(); i++) {
+                const auto& richiesta = batch[i];
+                if (richiesta.codice == static_cast<uint16_t>(Operazione::Statistiche) ||
+                    richiesta.codice == codice_protocollo) {
+                    continue;
+                }
+                std::string normalized = normalize_reaction(richiesta.testo);
+                chiavi[i] = static_cast<char>(richiesta.codice) + normalized;
+                if (auto voce = memoria.find(chiavi[i]); voce != nullptr) {
+                    stats.hit_memoria++;
+                    da_cache.push_back(*voce);
+                    risposte[i] = &da_cache.back();
+                    continue;
+                }
+                if (persistent != nullptr && richiesta.codice == static_cast<uint16_t>(Operazione::Bilanciamento)) {
+                    if (auto voce = persistent->find(normalized); voce.has_value()) {
+                        stats.hit_file++;
+                        da_cache.push_back(std::move(voce).value());
+                        risposte[i] = &da_cache.back();
+                        memoria.insert(chiavi[i], da_cache.back());
+                        continue;
+                    }
+                }
+                auto [it, nuova] = da_calcolare.try_emplace(chiavi[i], primi.size());
+                if (nuova) primi.push_back(i);
+                calcolo_di[i] = it->second;
+            }
+
+            std::vector<VoceCache> calcolate(primi.size());
+            auto inizio = std::chrono::steady_clock::now();
+            constexpr size_t min_per_thread = 16;
+            pool.parallel_for(primi.size(), min_per_thread, [&](size_t begin, size_t end) {
+                for (size_t j = begin; j < end; j++) {
+                    calcolate[j] = compute(batch[primi[j]].codice, batch[primi[j]].testo);
+                }
+            });
+            stats.tempo_calcolo += std::chrono::steady_clock::now() - inizio;
+            stats.calcolate += primi.size();
+
+            for (size_t j = 0; j < primi.size(); j++) {
+                const auto& richiesta = batch[primi[j]];
+                if (persistent != nullptr && richiesta.codice == static_cast<uint16_t>(Operazione::Bilanciamento)) {
+                    persistent->insert(std::string_view{chiavi[primi[j]]}.substr(1), calcolate[j]);
+                }
+                memoria.insert(chiavi[primi[j]], calcolate[j]);
+            }
+
+            for (size_t i = 0; i < batch.size(); i++) {
+                const auto& richiesta = batch[i];
+                if (richiesta.codice == static_cast<uint16_t>(Operazione::Statistiche)) {
+                    append_response(*richiesta.client, richiesta.id, Esito::Ok,
+                                    format_statistiche(stats, clients.size(), memoria.size()));
+                    continue;
+                }
+                if (richiesta.codice == codice_protocollo) {
+                    append_response(*richiesta.client, richiesta.id, Esito::Protocollo, richiesta.testo);
+                    continue;
+                }
+                const VoceCache& voce = risposte[i] != nullptr ? *risposte[i] : calcolate[calcolo_di[i]];
+                if (voce.errore) stats.errori++;
+                append_response(*richiesta.client, richiesta.id, voce.errore ? Esito::Errore : Esito::Ok, voce.testo);
+            }
+        }
+
+        for (auto& client : clients) {
+            while (client->out_pos < client->out.size()) {
+                size_t restanti = client->out.size() - client->out_pos;
+                ssize_t scritti = write(client->fd, client->out.data() + client->out_pos, restanti);
+                if (scritti <= 0) {
+                    if (scritti < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                        client->closing = true;
+                        client->out_pos = client->out.size();
+                    }
+                    break;
+                }
+                client->out_pos += static_cast<size_t>(scritti);
+            }
+            if (client->out_pos == client->out.size()) {
+                client->out.clear();
+                client->out_pos = 0;
+            }
+        }
+        // un client chiuso resta finché ha richieste complete nel buffer, rimaste fuori da un batch pieno
+        std::erase_if(clients, [](const std::unique_ptr<Client>& client) {
+            if (!client->closing || !client->out.empty() || has_request(*client)) return false;
+            close(client->fd);
+            return true;
+        });
+    }
+
+    for (const auto& client : clients) close(client->fd);
+    close(listener);
+    sigaction(SIGINT, &previous_int, nullptr);
+    sigaction(SIGTERM, &previous_term, nullptr);
+    close(signal_pipe[0]);
+    close(signal_pipe[1]);
+    signal_pipe[0] = signal_pipe[1] = -1;
+    unlink(path);
+    std::fprintf(stderr, "%s", format_statistiche(stats, 0, memoria.size()).c_str());
+    return 0;
+}
+
+#endif
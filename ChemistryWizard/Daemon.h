@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// protocollo del demone: ogni messaggio, in entrambe le direzioni, è un'intestazione di 12 byte in little endian
+// seguita da `lunghezza` byte di testo UTF-8. Il client può mandare più richieste senza aspettare le risposte:
+// ognuna riporta l'`id` della propria richiesta e, sulla stessa connessione, arrivano nell'ordine di invio.
+// l'intestazione è `lunghezza` (u32), `id` (u32), codice (u16: Operazione nelle richieste, Esito nelle risposte)
+// e due byte riservati a zero.
+enum class Operazione : uint16_t {
+    Bilanciamento = 1,
+    // riservate: i motori non le implementano ancora, quindi il demone le rifiuta come operazioni non valide
+    Nomenclatura = 2,
+    Riduzione = 3,
+    // massa molare di uno o più composti, es. `2H2 + O2`
+    Massa = 4,
+    // contatori del demone, una riga `nome valore` per contatore; il testo della richiesta viene ignorato
+    Statistiche = 5,
+};
+
+enum class Esito : uint16_t {
+    Ok = 0,
+    // il testo della risposta è il messaggio d'errore del motore
+    Errore = 1,
+    // operazione sconosciuta o messaggio troppo lungo: il demone chiude la connessione dopo questa risposta
+    Protocollo = 2,
+};
+
+inline constexpr size_t header_size = 12;
+inline constexpr uint32_t max_message_size = 1u << 20;
+
+// serve le richieste sul socket Unix `path` finché non riceve SIGINT o SIGTERM.
+// `cache_path` è la cache persistente dei bilanciamenti, nullptr per tenere solo quella in memoria
+int run_daemon(const char* path, const char* cache_path);
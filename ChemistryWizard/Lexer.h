@@ -0,0 +1,210 @@
+#pragma once
+#include "Actions.h"
+
+#include <cstdint>
+
+// tabella simbolo -> indice in `elements`, indicizzata da maiuscola e minuscola opzionale (0 se assente)
+inline int symbol_index(char upper, char lower) {
+    static const auto table = [] {
+        std::array<uint8_t, 26 * 27> t{};
+        for (size_t i = 0; i < elements.size(); i++) {
+            auto name = elements[i]->name();
+            size_t lo = name.size() > 1 ? static_cast<size_t>(name[1] - 'a' + 1) : 0;
+            t[static_cast<size_t>(name[0] - 'A') * 27 + lo] = static_cast<uint8_t>(i + 1);
+        }
+        return t;
+    }();
+    size_t lo = lower == '\0' ? 0 : static_cast<size_t>(lower - 'a' + 1);
+    return static_cast<int>(table[static_cast<size_t>(upper - 'A') * 27 + lo]) - 1;
+}
+
+enum class TipoToken {
+    Elemento,
+    Numero,
+    Pedice,
+    Carica,
+    ApertaParentesi,
+    ChiusaParentesi,
+    Piu,
+    Freccia,
+    Idrato,
+    Fine,
+    NonValido
+};
+
+struct Token {
+    TipoToken tipo;
+    // Numero/Pedice: il valore; Carica: il valore con segno; Elemento: l'indice in `elements`, -1 se sconosciuto;
+    // NonValido: il code point, o `numero_troppo_grande` per un numero oltre il limite del lexer
+    long long valore = 0;
+    char simbolo[2] = {'\0', '\0'};
+
+    static constexpr long long numero_troppo_grande = -1;
+};
+
+// legge direttamente il testo in UTF-8 (CharT = char) o UTF-16 (CharT = char16_t), senza conversioni,
+// riconoscendo anche pedici (H₂O), cariche in apice (Fe³⁺), frecce (→ ⇌ ⟶) e il punto degli idrati (·)
+template <typename CharT>
+requires std::same_as<CharT, char> || std::same_as<CharT, char16_t>
+class Lexer {
+    std::basic_string_view<CharT> m_text;
+    size_t m_pos = 0;
+
+    static constexpr long long max_number = 1'000'000'000;
+
+    // decodifica il code point alla posizione corrente senza avanzare; `len` riceve il numero di unità lette
+    char32_t peek(size_t& len) const {
+        len = 1;
+        if (m_pos >= m_text.size()) return U'\0';
+        auto unit = static_cast<char32_t>(static_cast<std::make_unsigned_t<CharT>>(m_text[m_pos]));
+        if constexpr (std::same_as<CharT, char16_t>) {
+            if (unit >= 0xD800 && unit < 0xDC00 && m_pos + 1 < m_text.size()) {
+                auto low = static_cast<char32_t>(m_text[m_pos + 1]);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    len = 2;
+                    return 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+                }
+            }
+            return unit;
+        } else {
+            if (unit < 0x80) return unit;
+            size_t extra = unit >= 0xF0 ? 3 : unit >= 0xE0 ? 2 : unit >= 0xC0 ? 1 : 0;
+            if (extra == 0 || m_pos + extra >= m_text.size()) return U'\uFFFD';
+            char32_t cp = unit & (0x3F >> extra);
+            for (size_t i = 1; i <= extra; i++) {
+                auto cont = static_cast<unsigned char>(m_text[m_pos + i]);
+                if ((cont & 0xC0) != 0x80) return U'\uFFFD';
+                cp = (cp << 6) | (cont & 0x3F);
+            }
+            len = extra + 1;
+            return cp;
+        }
+    }
+
+    static int subscript_digit(char32_t cp) {
+        return cp >= U'₀' && cp <= U'₉' ? static_cast<int>(cp - U'₀') : -1;
+    }
+    static int superscript_digit(char32_t cp) {
+        switch (cp) {
+        case U'⁰':
+            return 0;
+        case U'¹':
+            return 1;
+        case U'²':
+            return 2;
+        case U'³':
+            return 3;
+        default:
+            return cp >= U'⁴' && cp <= U'⁹' ? static_cast<int>(cp - U'⁴') + 4 : -1;
+        }
+    }
+    static int ascii_digit(char32_t cp) { return cp >= U'0' && cp <= U'9' ? static_cast<int>(cp - U'0') : -1; }
+    static bool is_space(char32_t cp) {
+        // anche gli spazi non separabili e sottili che si trovano spesso nei documenti
+        return cp == U' ' || cp == U'\t' || cp == U'\r' || cp == U'\n' || cp == U'\u00A0' || cp == U'\u2009' ||
+               cp == U'\u202F';
+    }
+
+    // legge tutte le cifre anche oltre `max_number`, ma in quel caso restituisce -1
+    template <typename DigitFn>
+    long long read_number(DigitFn digit) {
+        long long n = 0;
+        size_t len = 0;
+        for (char32_t cp = peek(len); digit(cp) >= 0; cp = peek(len)) {
+            if (n >= 0) n = n * 10 + digit(cp);
+            if (n > max_number) n = -1;
+            m_pos += len;
+        }
+        return n;
+    }
+    static Token number_token(TipoToken tipo, long long n, int sign = 1) {
+        if (n < 0) return {TipoToken::NonValido, Token::numero_troppo_grande};
+        return {tipo, sign * n};
+    }
+
+    // segno di una carica: `+`/`-` ascii o in apice, 0 se manca
+    int read_sign() {
+        size_t len = 0;
+        char32_t cp = peek(len);
+        int sign = cp == U'+' || cp == U'⁺' ? 1 : cp == U'-' || cp == U'⁻' || cp == U'−' ? -1 : 0;
+        if (sign != 0) m_pos += len;
+        return sign;
+    }
+
+    public:
+    explicit Lexer(std::basic_string_view<CharT> text) : m_text(text) {}
+
+    Token next() {
+        size_t len = 0;
+        char32_t cp = peek(len);
+        while (is_space(cp)) {
+            m_pos += len;
+            cp = peek(len);
+        }
+        if (m_pos >= m_text.size()) return {TipoToken::Fine};
+
+        if (cp >= U'A' && cp <= U'Z') {
+            m_pos += len;
+            Token tok{TipoToken::Elemento};
+            tok.simbolo[0] = static_cast<char>(cp);
+            char32_t lower = peek(len);
+            if (lower >= U'a' && lower <= U'z') {
+                m_pos += len;
+                tok.simbolo[1] = static_cast<char>(lower);
+            }
+            tok.valore = symbol_index(tok.simbolo[0], tok.simbolo[1]);
+            return tok;
+        }
+        if (ascii_digit(cp) >= 0) return number_token(TipoToken::Numero, read_number(ascii_digit));
+        if (subscript_digit(cp) >= 0) return number_token(TipoToken::Pedice, read_number(subscript_digit));
+        if (superscript_digit(cp) >= 0) {
+            long long n = read_number(superscript_digit);
+            int sign = read_sign();
+            if (sign == 0) return {TipoToken::NonValido, static_cast<long long>(cp)};
+            return number_token(TipoToken::Carica, n, sign);
+        }
+        switch (cp) {
+        case U'⁺':
+        case U'⁻':
+            return {TipoToken::Carica, read_sign()};
+        case U'^': {
+            m_pos += len;
+            long long n = ascii_digit(peek(len)) >= 0 ? read_number(ascii_digit) : 1;
+            int sign = read_sign();
+            if (sign == 0) return {TipoToken::NonValido, static_cast<long long>(cp)};
+            return number_token(TipoToken::Carica, n, sign);
+        }
+        case U'(':
+        case U'[':
+            m_pos += len;
+            return {TipoToken::ApertaParentesi};
+        case U')':
+        case U']':
+            m_pos += len;
+            return {TipoToken::ChiusaParentesi};
+        case U'+':
+            m_pos += len;
+            return {TipoToken::Piu};
+        case U'-': {
+            m_pos += len;
+            if (peek(len) != U'>') return {TipoToken::NonValido, static_cast<long long>(cp)};
+            m_pos += len;
+            return {TipoToken::Freccia};
+        }
+        case U'→':
+        case U'⇌':
+        case U'⟶':
+            m_pos += len;
+            return {TipoToken::Freccia};
+        case U'·':
+        case U'⋅':
+        case U'•':
+        case U'*':
+            m_pos += len;
+            return {TipoToken::Idrato};
+        default:
+            m_pos += len;
+            return {TipoToken::NonValido, static_cast<long long>(cp)};
+        }
+    }
+};
@@ -0,0 +1,463 @@
+#include "Network.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+// a * x + b * y, false in caso di overflow. LLONG_MIN conta come overflow, così gcd e negazioni restano definiti
+static bool checked_mul_add(long long a, long long x, long long b, long long y, long long& out) {
+    long long ax = 0;
+    long long by = 0;
+    long long result = 0;
+    if (!checked_mul(a, x, ax) || !checked_mul(b, y, by) || !checked_add(ax, by, result)) return false;
+    if (result == std::numeric_limits<long long>::min()) return false;
+    out = result;
+    return true;
+}
+
+// a * x + b * y su due vettori sparsi ordinati, unendo gli indici
+static bool combine(const VettoreSparso& x, long long a, const VettoreSparso& y, long long b, VettoreSparso& out) {
+    out.clear();
+    out.reserve(x.size() + y.size());
+    auto xi = x.begin();
+    auto yi = y.begin();
+    while (xi != x.end() || yi != y.end()) {
+        size_t idx = 0;
+        long long vx = 0;
+        long long vy = 0;
+        bool from_x = xi != x.end() && (yi == y.end() || xi->first <= yi->first);
+        bool from_y = yi != y.end() && (xi == x.end() || yi->first <= xi->first);
+        if (from_x) {
+            idx = xi->first;
+            vx = (xi++)->second;
+        }
+        if (from_y) {
+            idx = yi->first;
+            vy = (yi++)->second;
+        }
+        long long v = 0;
+        if (!checked_mul_add(a, vx, b, vy, v)) return false;
+        if (v != 0) out.emplace_back(idx, v);
+    }
+    return true;
+}
+
+static long long value_at(const VettoreSparso& v, size_t idx) {
+    auto it = std::ranges::lower_bound(v, idx, {}, &std::pair<size_t, long long>::first);
+    return it != v.end() && it->first == idx ? it->second : 0;
+}
+
+static void divide_by_gcd(VettoreSparso& v, VettoreSparso& w) {
+    // quasi sempre il massimo comun divisore arriva a 1 dopo pochi valori
+    long long g = 0;
+    for (auto it = v.begin(); it != v.end() && g != 1; ++it) g = std::gcd(g, it->second);
+    for (auto it = w.begin(); it != w.end() && g != 1; ++it) g = std::gcd(g, it->second);
+    if (g <= 1) return;
+    for (auto& [_, value] : v) value /= g;
+    for (auto& [_, value] : w) value /= g;
+}
+
+// oltre questo numero di specie o reazioni non si enumerano i raggi estremi
+static constexpr size_t max_raggi = 256;
+// limite ai confronti tra raggi nel test di adiacenza, che per ogni vincolo costa O(R³) nel caso peggiore
+static constexpr size_t max_confronti = size_t{1} << 24;
+
+struct Eliminazione {
+    size_t rango = 0;
+    // combinazioni intere dei vettori di ingresso che danno il vettore nullo
+    std::vector<VettoreSparso> relazioni{};
+};
+
+// eliminazione di Gauss incrementale e senza frazioni su vettori sparsi di lunghezza `dimensione`.
+// ogni vettore viene ridotto contro la base nell'ordine in cui è stata costruita: ogni elemento della base è nullo
+// sui pivot di quelli precedenti, quindi un pivot già eliminato non ricompare. Se il vettore si annulla, la
+// combinazione che lo ha prodotto è una relazione lineare tra gli ingressi, altrimenti entra nella base
+static std::optional<Eliminazione> eliminate(const std::vector<VettoreSparso>& vettori, size_t dimensione) {
+    struct ElementoBase {
+        VettoreSparso vettore;
+        VettoreSparso combinazione;
+        size_t pivot;
+    };
+    std::vector<ElementoBase> base{};
+    std::vector<size_t> base_of(dimensione, std::numeric_limits<size_t>::max());
+    // come pivot si preferiscono gli indici presenti in pochi vettori, così la base resta sparsa
+    std::vector<size_t> frequenza(dimensione, 0);
+    for (const auto& v : vettori) {
+        for (const auto& [idx, _] : v) frequenza[idx]++;
+    }
+    Eliminazione risultato{};
+    VettoreSparso scratch{};
+
+    for (size_t i = 0; i < vettori.size(); i++) {
+        VettoreSparso v = vettori[i];
+        VettoreSparso combinazione{{i, 1}};
+        while (true) {
+            size_t best = std::numeric_limits<size_t>::max();
+            long long v_pivot = 0;
+            for (const auto& [idx, value] : v) {
+                if (base_of[idx] < best) {
+                    best = base_of[idx];
+                    v_pivot = value;
+                }
+            }
+            if (best == std::numeric_limits<size_t>::max()) break;
+
+            const auto& b = base[best];
+            long long b_pivot = value_at(b.vettore, b.pivot);
+            long long g = std::gcd(b_pivot, v_pivot);
+            if (!combine(v, b_pivot / g, b.vettore, -v_pivot / g, scratch)) return {};
+            std::swap(v, scratch);
+            if (!combine(combinazione, b_pivot / g, b.combinazione, -v_pivot / g, scratch)) return {};
+            std::swap(combinazione, scratch);
+            divide_by_gcd(v, combinazione);
+        }
+
+        if (v.empty()) {
+            // la relazione si legge meglio con il vettore appena aggiunto in positivo
+            if (value_at(combinazione, i) < 0) {
+                for (auto& [_, value] : combinazione) value = -value;
+            }
+            risultato.relazioni.push_back(std::move(combinazione));
+            continue;
+        }
+        // a parità di frequenza, il pivot col valore più piccolo limita la crescita dei coefficienti
+        auto pivot = std::ranges::min_element(
+        v, {}, [&](const auto& entry) { return std::pair{frequenza[entry.first], std::abs(entry.second)}; });
+        base_of[pivot->first] = base.size();
+        base.push_back({std::move(v), std::move(combinazione), pivot->first});
+    }
+    risultato.rango = base.size();
+    return risultato;
+}
+
+// raggi estremi del cono {x >= 0 : a·x = 0 per ogni vincolo a}, con il metodo della doppia descrizione:
+// si parte dai versori e ogni vincolo tiene i raggi su cui si annulla, più le combinazioni positive delle coppie
+// adiacenti con segno opposto. Due raggi sono adiacenti se nessun altro ha il supporto contenuto nell'unione dei loro;
+// prima del test si scartano le coppie la cui unione ha più di k + 2 indici dopo k vincoli, che non possono esserlo.
+// il numero di raggi può crescere in modo esponenziale, quindi oltre `max_raggi` raggi o `max_confronti` confronti
+// si rinuncia e il chiamante ripiega sull'eliminazione
+static std::optional<std::vector<VettoreSparso>> extreme_rays(const std::vector<VettoreSparso>& vincoli,
+                                                              size_t dimensione, size_t max_raggi) {
+    struct Raggio {
+        VettoreSparso x;
+        std::vector<uint64_t> supporto;
+    };
+    if (dimensione > max_raggi) return {};
+    const size_t words = (dimensione + 63) / 64;
+    std::vector<Raggio> raggi{};
+    for (size_t i = 0; i < dimensione; i++) {
+        Raggio raggio{{{i, 1}}, std::vector<uint64_t>(words, 0)};
+        raggio.supporto[i / 64] |= uint64_t{1} << (i % 64);
+        raggi.push_back(std::move(raggio));
+    }
+
+    std::vector<Raggio> nuovi{};
+    std::vector<uint64_t> unione(words);
+    VettoreSparso scratch{};
+    size_t processati = 0;
+    size_t confronti = 0;
+    for (const auto& a : vincoli) {
+        std::vector<long long> prodotti(raggi.size(), 0);
+        std::vector<size_t> positivi{};
+        std::vector<size_t> negativi{};
+        nuovi.clear();
+        for (size_t r = 0; r < raggi.size(); r++) {
+            for (const auto& [idx, value] : a) {
+                long long x = value_at(raggi[r].x, idx);
+                if (x != 0 && !checked_mul_add(value, x, 1, prodotti[r], prodotti[r])) return {};
+            }
+            if (prodotti[r] > 0)
+                positivi.push_back(r);
+            else if (prodotti[r] < 0)
+                negativi.push_back(r);
+            else
+                nuovi.push_back(raggi[r]);
+        }
+        for (size_t p : positivi) {
+            for (size_t n : negativi) {
+                size_t n_unione = 0;
+                for (size_t w = 0; w < words; w++) {
+                    unione[w] = raggi[p].supporto[w] | raggi[n].supporto[w];
+                    n_unione += static_cast<size_t>(std::popcount(unione[w]));
+                }
+                if (n_unione > processati + 2) continue;
+                confronti += raggi.size();
+                if (confronti > max_confronti) return {};
+                bool adiacenti = true;
+                for (size_t r = 0; r < raggi.size() && adiacenti; r++) {
+                    if (r == p || r == n) continue;
+                    bool contenuto = true;
+                    for (size_t w = 0; w < words && contenuto; w++) {
+                        contenuto = (raggi[r].supporto[w] & ~unione[w]) == 0;
+                    }
+                    adiacenti = !contenuto;
+                }
+                if (!adiacenti) continue;
+                if (nuovi.size() == max_raggi) return {};
+                if (!combine(raggi[p].x, -prodotti[n], raggi[n].x, prodotti[p], scratch)) return {};
+                VettoreSparso vuoto{};
+                divide_by_gcd(scratch, vuoto);
+                nuovi.push_back({scratch, unione});
+            }
+        }
+        std::swap(raggi, nuovi);
+        processati++;
+    }
+
+    std::vector<VettoreSparso> risultato{};
+    for (auto& raggio : raggi) risultato.push_back(std::move(raggio.x));
+    return risultato;
+}
+
+template <typename CharT>
+static AnalisiRete analyze_text(std::basic_string_view<CharT> text) {
+    AnalisiRete analisi{};
+    std::unordered_map<std::string, size_t> index_of{};
+    auto species_index = [&](const Composto& composto) {
+        auto [it, inserted] =
+        index_of.try_emplace(format_formula(composto, false).toStdString(), analisi.specie.size());
+        if (inserted) {
+            analisi.specie.push_back(composto);
+            analisi.specie.back().set_quantity(1);
+        }
+        return it->second;
+    };
+
+    size_t start = 0;
+    while (start <= text.size()) {
+        size_t end = start;
+        while (end < text.size() && text[end] != ';' && text[end] != '\n') end++;
+        auto riga = text.substr(start, end - start);
+        start = end + 1;
+        if (std::ranges::all_of(riga, [](CharT c) { return c == ' ' || c == '\t' || c == '\r'; })) continue;
+
+        size_t numero = analisi.reazioni.size() + 1;
+        auto risultato = balance_equation(riga);
+        if (!risultato.ok()) {
+            analisi.errore = QString::asprintf("Reazione %llu: ", static_cast<unsigned long long>(numero));
+            analisi.errore.append(risultato.errore);
+            return analisi;
+        }
+        // senza coefficienti unici si accettano quelli scritti, purché conservino gli elementi
+        if (!risultato.testo.isEmpty() && !verify_balance(riga).bilanciata()) {
+            error("Reazione %llu: impossibile trovare coefficienti unici", static_cast<unsigned long long>(numero));
+            analisi.errore = last_error;
+            return analisi;
+        }
+
+        auto& reazione = analisi.reazioni.emplace_back(std::move(risultato.reazione).value());
+        VettoreSparso colonna{};
+        for (const auto& reagente : reazione.reagenti) {
+            colonna.emplace_back(species_index(reagente), -static_cast<long long>(reagente.quantity()));
+        }
+        for (const auto& prodotto : reazione.prodotti) {
+            colonna.emplace_back(species_index(prodotto), static_cast<long long>(prodotto.quantity()));
+        }
+        // una specie presente da entrambe le parti (es. un catalizzatore) occupa una sola riga
+        std::ranges::sort(colonna);
+        VettoreSparso unita{};
+        for (const auto& [idx, value] : colonna) {
+            if (!unita.empty() && unita.back().first == idx)
+                unita.back().second += value;
+            else
+                unita.emplace_back(idx, value);
+        }
+        std::erase_if(unita, [](const auto& entry) { return entry.second == 0; });
+        analisi.colonne.push_back(std::move(unita));
+    }
+    if (analisi.reazioni.empty()) {
+        error("Nessuna reazione");
+        analisi.errore = last_error;
+        return analisi;
+    }
+
+    const size_t n_specie = analisi.specie.size();
+    const size_t n_reazioni = analisi.reazioni.size();
+    auto set_overflow = [&]() {
+        error("Coefficienti troppo grandi per analizzare la rete");
+        analisi.errore = last_error;
+    };
+
+    // le reazioni dipendenti sono lo spazio nullo destro della matrice stechiometrica
+    auto colonne = eliminate(analisi.colonne, n_specie);
+    if (!colonne.has_value()) {
+        set_overflow();
+        return analisi;
+    }
+    analisi.rango = colonne->rango;
+    analisi.dipendenze = std::move(colonne->relazioni);
+
+    // le quantità conservate sono lo spazio nullo sinistro: se la rete è piccola se ne cercano i generatori a pesi
+    // non negativi, altrimenti basta la stessa eliminazione sulle righe
+    if (auto positive = extreme_rays(analisi.colonne, n_specie, max_raggi); positive.has_value()) {
+        analisi.conservate = std::move(positive).value();
+    } else {
+        analisi.conservate_limitate = true;
+        std::vector<VettoreSparso> righe(n_specie);
+        for (size_t j = 0; j < n_reazioni; j++) {
+            for (const auto& [idx, value] : analisi.colonne[j]) righe[idx].emplace_back(j, value);
+        }
+        auto conservate = eliminate(righe, n_reazioni);
+        if (!conservate.has_value()) {
+            set_overflow();
+            return analisi;
+        }
+        analisi.conservate = std::move(conservate->relazioni);
+    }
+
+    // gli intermedi sono prodotti da una reazione e consumati da un'altra. I modi di flusso elementari sono le
+    // combinazioni minime a moltiplicatori non negativi che li annullano tutti; la reazione netta è quella del modo,
+    // se è uno solo
+    std::vector<bool> prodotta(n_specie, false);
+    std::vector<bool> consumata(n_specie, false);
+    for (const auto& colonna : analisi.colonne) {
+        for (const auto& [idx, value] : colonna) (value > 0 ? prodotta : consumata)[idx] = true;
+    }
+    std::vector<VettoreSparso> ridotte(n_reazioni);
+    std::vector<VettoreSparso> intermedi(n_specie);
+    for (size_t j = 0; j < n_reazioni; j++) {
+        for (const auto& entry : analisi.colonne[j]) {
+            if (prodotta[entry.first] && consumata[entry.first]) {
+                ridotte[j].push_back(entry);
+                intermedi[entry.first].emplace_back(j, entry.second);
+            }
+        }
+    }
+    std::erase_if(intermedi, [](const VettoreSparso& riga) { return riga.empty(); });
+    if (auto modi = extreme_rays(intermedi, n_reazioni, max_raggi); modi.has_value()) {
+        analisi.modi = std::move(modi).value();
+        if (analisi.modi.size() == 1) analisi.moltiplicatori = analisi.modi.front();
+    } else {
+        // troppi modi da enumerare: si cerca direttamente l'unica combinazione, se c'è
+        analisi.modi_limitati = true;
+        auto netta = eliminate(ridotte, n_specie);
+        if (!netta.has_value()) {
+            set_overflow();
+            return analisi;
+        }
+        if (netta->relazioni.size() == 1) {
+            auto& relazione = netta->relazioni.front();
+            bool positive = std::ranges::all_of(relazione, [](const auto& entry) { return entry.second > 0; });
+            bool negative = std::ranges::all_of(relazione, [](const auto& entry) { return entry.second < 0; });
+            if (negative) {
+                for (auto& [_, value] : relazione) value = -value;
+            }
+            if (positive || negative) analisi.moltiplicatori = std::move(relazione);
+        }
+    }
+    return analisi;
+}
+
+AnalisiRete analyze_network(std::string_view text) {
+    return analyze_text(text);
+}
+AnalisiRete analyze_network(std::u16string_view text) {
+    return analyze_text(text);
+}
+
+// somma delle reazioni pesate con i moltiplicatori
+static std::optional<Reazione> net_reaction(const AnalisiRete& analisi, const VettoreSparso& moltiplicatori) {
+    if (moltiplicatori.empty()) return {};
+    VettoreSparso netto{};
+    VettoreSparso scratch{};
+    for (const auto& [j, m] : moltiplicatori) {
+        if (!combine(netto, 1, analisi.colonne[j], m, scratch)) return {};
+        std::swap(netto, scratch);
+    }
+    VettoreSparso vuoto{};
+    divide_by_gcd(netto, vuoto);
+
+    Reazione netta{};
+    for (const auto& [idx, value] : netto) {
+        auto& side = value < 0 ? netta.reagenti : netta.prodotti;
+        side.push_back(analisi.specie[idx]);
+        side.back().set_quantity(static_cast<size_t>(std::abs(value)));
+    }
+    return netta;
+}
+
+static QString format_relazione(const VettoreSparso& relazione, auto&& nome) {
+    QString text{};
+    for (const auto& [idx, value] : relazione) {
+        if (text.isEmpty())
+            text.append(value < 0 ? "-" : "");
+        else
+            text.append(value < 0 ? " - " : " + ");
+        if (std::abs(value) != 1) text.append(QString::asprintf("%lld ", std::abs(value)));
+        text.append(nome(idx));
+    }
+    return text;
+}
+
+QString format_analisi(const AnalisiRete& analisi) {
+    if (!analisi.ok()) return analisi.errore;
+
+    auto nome_reazione = [](size_t j) { return QString::asprintf("R%llu", static_cast<unsigned long long>(j + 1)); };
+    auto nome_specie = [&](size_t i) { return format_formula(analisi.specie[i]); };
+    QString text = QString::asprintf("Specie: %llu, reazioni: %llu, rango: %llu\n",
+                                     static_cast<unsigned long long>(analisi.specie.size()),
+                                     static_cast<unsigned long long>(analisi.reazioni.size()),
+                                     static_cast<unsigned long long>(analisi.rango));
+    for (size_t j = 0; j < analisi.reazioni.size(); j++) {
+        text.append(nome_reazione(j));
+        text.append(": ");
+        text.append(format_equazione(analisi.reazioni[j]));
+        text.append("\n");
+    }
+
+    if (analisi.dipendenze.empty()) {
+        text.append("Reazioni indipendenti\n");
+    } else {
+        text.append("Reazioni dipendenti:\n");
+        for (const auto& relazione : analisi.dipendenze) {
+            text.append("\t");
+            text.append(format_relazione(relazione, nome_reazione));
+            text.append(" = 0\n");
+        }
+    }
+
+    if (!analisi.conservate.empty()) {
+        text.append(analisi.conservate_limitate ? "Quantità conservate (base, rete troppo grande per i pesi "
+                                                  "non negativi):\n"
+                                                : "Quantità conservate:\n");
+        for (const auto& relazione : analisi.conservate) {
+            text.append("\t");
+            text.append(format_relazione(relazione, nome_specie));
+            text.append("\n");
+        }
+    }
+
+    if (analisi.modi_limitati) text.append("Modi di flusso elementari: troppi da enumerare\n");
+    if (analisi.modi.size() > 1) {
+        text.append("Modi di flusso elementari:\n");
+        for (const auto& modo : analisi.modi) {
+            text.append("\t");
+            text.append(format_relazione(modo, nome_reazione));
+            text.append(": ");
+            auto netta = net_reaction(analisi, modo);
+            bool ciclo = netta.has_value() && netta->reagenti.empty() && netta->prodotti.empty();
+            text.append(!netta.has_value() ? QString{"?"} : ciclo ? QString{"ciclo"} : format_equazione(netta.value()));
+            text.append("\n");
+        }
+    }
+    if (auto netta = net_reaction(analisi, analisi.moltiplicatori); netta.has_value()) {
+        text.append("Reazione netta (");
+        text.append(format_relazione(analisi.moltiplicatori, nome_reazione));
+        text.append("): ");
+        text.append(format_equazione(netta.value()));
+        text.append("\n");
+    } else {
+        text.append("Reazione netta: nessuna combinazione unica a coefficienti positivi annulla gli intermedi\n");
+    }
+    return text;
+}
+
+Risultato do_network(QStringView argument) {
+    auto analisi = analyze_network(to_u16(argument));
+    if (!analisi.ok()) return {.errore = analisi.errore};
+    return {.reazione = net_reaction(analisi, analisi.moltiplicatori), .testo = format_analisi(analisi)};
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "Actions.h"
+
+// vettore sparso a coefficienti interi: coppie (indice, valore) ordinate per indice, senza zeri
+using VettoreSparso = std::vector<std::pair<size_t, long long>>;
+
+// analisi di un insieme di reazioni accoppiate tramite la matrice stechiometrica sparsa specie x reazioni,
+// in cui i reagenti contano in negativo e i prodotti in positivo
+struct AnalisiRete {
+    QString errore{};
+    std::vector<Composto> specie{};
+    // reazioni bilanciate, nell'ordine del testo
+    std::vector<Reazione> reazioni{};
+    // colonne della matrice stechiometrica, una per reazione, indicizzate per specie
+    std::vector<VettoreSparso> colonne{};
+    size_t rango = 0;
+    // combinazioni di reazioni (indicizzate per reazione) che si annullano: una per ogni reazione dipendente
+    std::vector<VettoreSparso> dipendenze{};
+    // combinazioni di specie (indicizzate per specie) la cui quantità totale non cambia, a pesi non negativi
+    // quando la rete è abbastanza piccola da enumerarle
+    std::vector<VettoreSparso> conservate{};
+    // modi di flusso elementari sulle reazioni scritte come irreversibili, vuoto se sono troppi da enumerare
+    std::vector<VettoreSparso> modi{};
+    // l'enumerazione ha superato i limiti: `conservate` è solo una base, con pesi anche negativi, e `modi` è vuoto
+    bool conservate_limitate = false;
+    bool modi_limitati = false;
+    // quante volte va presa ogni reazione perché gli intermedi si annullino, vuoto se non esiste un modo unico
+    VettoreSparso moltiplicatori{};
+
+    bool ok() const { return errore.isEmpty(); }
+};
+
+// le reazioni sono separate da `;` o da un a capo e vengono bilanciate una per una, se possibile
+AnalisiRete analyze_network(std::string_view text);
+AnalisiRete analyze_network(std::u16string_view text);
+QString format_analisi(const AnalisiRete& analisi);
+
+Risultato do_network(QStringView argument);
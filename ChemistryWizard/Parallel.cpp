@@ -0,0 +1,62 @@
+#include "Parallel.h"
+
+#include <algorithm>
+
+static thread_local const WorkerPool* current_pool = nullptr;
+
+WorkerPool::WorkerPool(size_t n_threads) {
+    if (n_threads == 0) n_threads = std::max(std::thread::hardware_concurrency(), 1u) - 1;
+    m_threads.reserve(n_threads);
+    for (size_t i = 0; i < n_threads; i++) {
+        m_threads.emplace_back([this](std::stop_token stop) { worker(stop); });
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    // request_stop sveglia i thread in attesa sulla condition_variable_any
+    for (auto& thread : m_threads) thread.request_stop();
+    m_threads.clear();
+}
+
+void WorkerPool::run_chunks(std::unique_lock<std::mutex>& lock) {
+    while (m_next < m_n_chunks) {
+        size_t begin = m_next++ * m_chunk;
+        size_t end = std::min(begin + m_chunk, m_size);
+        const task_t& task = *m_task;
+        lock.unlock();
+        task(begin, end);
+        lock.lock();
+        if (--m_pending == 0) m_finito.notify_all();
+    }
+}
+
+void WorkerPool::worker(std::stop_token stop) {
+    current_pool = this;
+    std::unique_lock lock{m_mutex};
+    while (m_sveglia.wait(lock, stop, [this] { return m_next < m_n_chunks; })) {
+        run_chunks(lock);
+    }
+}
+
+void WorkerPool::parallel_for(size_t n, size_t min_per_thread, const task_t& task) {
+    size_t n_chunks = std::min(m_threads.size() + 1, n / std::max<size_t>(min_per_thread, 1));
+    std::unique_lock lavoro{m_lavoro, std::defer_lock};
+    if (n_chunks <= 1 || current_pool == this || !lavoro.try_lock()) {
+        if (n > 0) task(0, n);
+        return;
+    }
+
+    std::unique_lock lock{m_mutex};
+    m_task = &task;
+    m_size = n;
+    m_chunk = (n + n_chunks - 1) / n_chunks;
+    m_n_chunks = (n + m_chunk - 1) / m_chunk;
+    m_next = 0;
+    m_pending = m_n_chunks;
+    m_sveglia.notify_all();
+    run_chunks(lock);
+    m_finito.wait(lock, [this] { return m_pending == 0; });
+    m_task = nullptr;
+    m_n_chunks = 0;
+    m_next = 0;
+}
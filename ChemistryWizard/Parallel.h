@@ -0,0 +1,41 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+// gruppo di thread creato una volta sola e riusato per ogni lavoro. parallel_for divide [0, n) in blocchi contigui
+// di almeno `min_per_thread` elementi; anche il thread chiamante esegue dei blocchi e torna solo quando sono
+// finiti tutti. Un solo lavoro alla volta: se il gruppo è già occupato, o se lo si chiama da uno dei suoi thread,
+// il lavoro viene eseguito per intero dal chiamante
+class WorkerPool {
+    using task_t = std::function<void(size_t, size_t)>;
+
+    std::mutex m_lavoro{};
+    std::mutex m_mutex{};
+    std::condition_variable_any m_sveglia{};
+    std::condition_variable m_finito{};
+    const task_t* m_task = nullptr;
+    size_t m_size = 0;
+    size_t m_chunk = 0;
+    size_t m_n_chunks = 0;
+    size_t m_next = 0;
+    size_t m_pending = 0;
+    std::vector<std::jthread> m_threads{};
+
+    // esegue blocchi del lavoro corrente finché ce ne sono; `lock` è tenuto all'ingresso e all'uscita
+    void run_chunks(std::unique_lock<std::mutex>& lock);
+    void worker(std::stop_token stop);
+
+    public:
+    // con 0 thread si usano quelli dell'hardware meno uno, dato che il chiamante lavora anche lui
+    explicit WorkerPool(size_t n_threads = 0);
+    ~WorkerPool();
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    void parallel_for(size_t n, size_t min_per_thread, const task_t& task);
+};
@@ -0,0 +1,517 @@
+#include "Prediction.h"
+#include "Parallel.h"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <unordered_set>
+
+// un composto ionico visto come catione + anione, ognuno con la propria unità di formula
+struct Ione {
+    std::vector<SingleElementQt> atomi;
+    int carica;
+};
+
+struct Specie {
+    const Composto& composto;
+    std::optional<ElementRef> elemento{};
+    std::optional<std::pair<Ione, Ione>> ioni{};
+};
+
+struct Bozza {
+    ClasseReazione classe;
+    std::vector<Composto> prodotti;
+    // indici dei reagenti che partecipano alla reazione; gli altri restano esclusi dal candidato
+    std::vector<size_t> reagenti{};
+};
+
+// oltre questi limiti la combinazione degli ioni esploderebbe: si tengono solo i candidati già generati
+static constexpr size_t max_ioni = 6;
+static constexpr size_t max_reagenti_ionici = 10;
+static constexpr size_t max_bozze = 4096;
+
+static bool same_element(ElementRef a, ElementRef b) {
+    return a->na() == b->na();
+}
+
+static bool has_state(ElementRef elem, int state) {
+    for (size_t i = 0; i < elem->size_no(); i++) {
+        if ((*elem)[i] == state) return true;
+    }
+    return false;
+}
+
+template <typename Pred>
+static std::vector<int> states_where(ElementRef elem, Pred pred) {
+    std::vector<int> states{};
+    for (size_t i = 0; i < elem->size_no(); i++) {
+        if (pred((*elem)[i])) states.push_back((*elem)[i]);
+    }
+    return states;
+}
+
+static bool is_diatomic(ElementRef elem) {
+    constexpr std::array diatomic{"H"sv, "N"sv, "O"sv, "F"sv, "Cl"sv, "Br"sv, "I"sv};
+    return std::ranges::find(diatomic, elem->name()) != diatomic.end();
+}
+
+static Composto make_elemental(ElementRef elem) {
+    std::pmr::vector<ElementQt> elems{};
+    elems.emplace_back(std::in_place_index<0>, elem, is_diatomic(elem) ? 2 : 1);
+    return Composto{std::move(elems), 1};
+}
+
+static bool same_ion(const Ione& a, const Ione& b) {
+    return a.carica == b.carica && std::ranges::equal(a.atomi, b.atomi, [](const auto& x, const auto& y) {
+        return x.quantity == y.quantity && same_element(x.element, y.element);
+    });
+}
+
+static bool is_ion(const Ione& ione, std::initializer_list<std::string_view> names) {
+    if (ione.atomi.size() != names.size()) return false;
+    return std::ranges::equal(ione.atomi, names, [](const SingleElementQt& a, std::string_view name) {
+        return a.quantity == 1 && a.element->name() == name;
+    });
+}
+
+// il numero di cationi e anioni è scelto in modo che la carica totale sia nulla
+static Composto make_salt(const Ione& catione, const Ione& anione) {
+    if (is_ion(catione, {"H"sv}) && is_ion(anione, {"O"sv, "H"sv})) {
+        std::pmr::vector<ElementQt> acqua{};
+        acqua.emplace_back(std::in_place_index<0>, catione.atomi[0].element, 2);
+        acqua.emplace_back(std::in_place_index<0>, anione.atomi[0].element, 1);
+        return Composto{std::move(acqua), 1};
+    }
+    int g = std::gcd(catione.carica, -anione.carica);
+    size_t n_catione = static_cast<size_t>(-anione.carica / g);
+    size_t n_anione = static_cast<size_t>(catione.carica / g);
+    std::pmr::vector<ElementQt> elems{};
+    for (const auto& atomo : catione.atomi) {
+        elems.emplace_back(std::in_place_index<0>, atomo.element, atomo.quantity * n_catione);
+    }
+    if (anione.atomi.size() == 1) {
+        elems.emplace_back(std::in_place_index<0>, anione.atomi[0].element, anione.atomi[0].quantity * n_anione);
+    } else if (n_anione == 1) {
+        for (const auto& atomo : anione.atomi) {
+            elems.emplace_back(std::in_place_index<0>, atomo.element, atomo.quantity);
+        }
+    } else {
+        elems.emplace_back(std::in_place_index<1>, GroupElementRef{anione.atomi.begin(), anione.atomi.end()},
+                           n_anione);
+    }
+    return Composto{std::move(elems), 1};
+}
+
+static Ione monatomic(ElementRef elem, int carica) {
+    return Ione{{SingleElementQt{elem, 1}}, carica};
+}
+
+// con O a -2 e H a +1, l'eventuale elemento rimanente deve avere uno stato di ossidazione ammesso
+static bool anion_consistent(const std::vector<SingleElementQt>& atomi, int carica) {
+    if (atomi.size() == 1) return has_state(atomi[0].element, carica);
+    int noti = 0;
+    const SingleElementQt* centrale = nullptr;
+    for (const auto& atomo : atomi) {
+        if (atomo.element->name() == "O") {
+            noti -= 2 * static_cast<int>(atomo.quantity);
+        } else if (atomo.element->name() == "H") {
+            noti += static_cast<int>(atomo.quantity);
+        } else if (centrale == nullptr) {
+            centrale = &atomo;
+        } else {
+            return true;
+        }
+    }
+    if (centrale == nullptr) return noti == carica;
+    int resto = carica - noti;
+    int quantita = static_cast<int>(centrale->quantity);
+    return resto % quantita == 0 && has_state(centrale->element, resto / quantita);
+}
+
+// il primo elemento fa da catione, il resto da anione; si prova ogni numero di ossidazione positivo del catione
+// e si scartano quelli che non lasciano all'anione una carica intera e ammessa
+static std::optional<std::pair<Ione, Ione>> split_ions(const Composto& composto) {
+    if (composto.size() < 2 || !std::holds_alternative<SingleElementQt>(composto[0])) return {};
+    const auto& catione = std::get<SingleElementQt>(composto[0]);
+
+    std::vector<SingleElementQt> atomi{};
+    size_t n_anioni = 1;
+    if (composto.size() == 2 && std::holds_alternative<GroupElementQt>(composto[1])) {
+        const auto& [group, size] = std::get<GroupElementQt>(composto[1]);
+        for (const auto& elem : group) {
+            atomi.push_back(elem);
+        }
+        n_anioni = size;
+    } else if (composto.size() == 2) {
+        const auto& single = std::get<SingleElementQt>(composto[1]);
+        atomi.push_back({single.element, 1});
+        n_anioni = single.quantity;
+    } else {
+        for (size_t i = 1; i < composto.size(); i++) {
+            if (!std::holds_alternative<SingleElementQt>(composto[i])) return {};
+            atomi.push_back(std::get<SingleElementQt>(composto[i]));
+        }
+    }
+
+    for (int q : states_where(catione.element, [](int s) { return s > 0; })) {
+        long long totale = static_cast<long long>(q) * static_cast<long long>(catione.quantity);
+        if (n_anioni == 0 || totale % static_cast<long long>(n_anioni) != 0) continue;
+        int carica = -static_cast<int>(totale / static_cast<long long>(n_anioni));
+        if (!anion_consistent(atomi, carica)) continue;
+        return std::pair{monatomic(catione.element, q), Ione{atomi, carica}};
+    }
+    return {};
+}
+
+static Specie classify(const Composto& composto) {
+    Specie specie{composto};
+    if (composto.size() == 1 && std::holds_alternative<SingleElementQt>(composto[0])) {
+        specie.elemento.emplace(std::get<SingleElementQt>(composto[0]).element);
+    } else {
+        specie.ioni = split_ions(composto);
+    }
+    return specie;
+}
+
+static bool contains_only(const Composto& composto, std::initializer_list<std::string_view> names,
+                          std::string_view required) {
+    bool found = false;
+    auto check = [&](const SingleElementQt& elem) {
+        found = found || elem.element->name() == required;
+        return std::ranges::find(names, elem.element->name()) != names.end();
+    };
+    for (const auto& variant : composto) {
+        if (std::holds_alternative<SingleElementQt>(variant)) {
+            if (!check(std::get<SingleElementQt>(variant))) return false;
+        } else {
+            for (const auto& elem : std::get<GroupElementQt>(variant).group) {
+                if (!check(elem)) return false;
+            }
+        }
+    }
+    return found;
+}
+
+static bool contains(const Composto& composto, std::string_view name) {
+    return std::ranges::any_of(composto, [&](const ElementQt& variant) {
+        if (std::holds_alternative<SingleElementQt>(variant))
+            return std::get<SingleElementQt>(variant).element->name() == name;
+        return std::ranges::any_of(std::get<GroupElementQt>(variant).group,
+                                   [&](const SingleElementQt& elem) { return elem.element->name() == name; });
+    });
+}
+
+static Composto make_oxide(ElementRef elem, int stato) {
+    return make_salt(monatomic(elem, stato), monatomic(ElementRef{ossigeno}, -2));
+}
+
+// l'ossigeno brucia ogni reagente fatto solo di C, H e O. Ogni combustibile ha la sua reazione: bruciati insieme
+// i coefficienti non sarebbero unici
+static void add_combustion(const std::vector<Specie>& specie, std::vector<Bozza>& bozze) {
+    auto is_oxygen = [](const Specie& s) { return s.elemento.has_value() && s.elemento.value()->name() == "O"; };
+    auto comburente = std::ranges::find_if(specie, is_oxygen);
+    if (comburente == specie.end()) return;
+    size_t indice_ossigeno = static_cast<size_t>(comburente - specie.begin());
+
+    for (size_t i = 0; i < specie.size(); i++) {
+        const auto& combustibile = specie[i].composto;
+        if (is_oxygen(specie[i]) || (!contains_only(combustibile, {"C"sv, "H"sv, "O"sv}, "C") &&
+                                     !contains_only(combustibile, {"C"sv, "H"sv, "O"sv}, "H"))) {
+            continue;
+        }
+        Bozza bozza{ClasseReazione::Combustione, {}, {indice_ossigeno, i}};
+        if (contains(combustibile, "C")) bozza.prodotti.push_back(make_oxide(ElementRef{carbonio}, 4));
+        if (contains(combustibile, "H")) bozza.prodotti.push_back(make_oxide(ElementRef{idrogeno}, 1));
+        bozze.push_back(std::move(bozza));
+    }
+}
+
+// scambio di ioni tra i reagenti ionici in `usati`. Se i cationi sono almeno quanti gli anioni ogni catione si lega
+// a un anione, altrimenti il contrario; ogni ione deve finire in almeno un prodotto, o i suoi elementi non si
+// bilancerebbero, quindi i rami che non possono più coprirli tutti vengono tagliati. I prodotti sono neutri per
+// costruzione. Con l'acqua tra i prodotti è una neutralizzazione, altrimenti un doppio scambio
+static void add_ion_exchange(const std::vector<Specie>& specie, const std::vector<size_t>& usati,
+                             std::vector<Bozza>& bozze) {
+    std::vector<const Ione*> cationi{};
+    std::vector<const Ione*> anioni{};
+    auto add_unique = [](std::vector<const Ione*>& ioni, const Ione& ione) {
+        if (std::ranges::none_of(ioni, [&](const Ione* altro) { return same_ion(*altro, ione); })) {
+            ioni.push_back(&ione);
+        }
+    };
+    for (size_t i : usati) {
+        add_unique(cationi, specie[i].ioni->first);
+        add_unique(anioni, specie[i].ioni->second);
+    }
+    if (cationi.size() > max_ioni || anioni.size() > max_ioni) return;
+
+    bool per_catione = cationi.size() >= anioni.size();
+    const auto& sorgenti = per_catione ? cationi : anioni;
+    const auto& destinazioni = per_catione ? anioni : cationi;
+    std::vector<size_t> scelta(sorgenti.size());
+    std::vector<size_t> usi(destinazioni.size(), 0);
+    size_t scoperte = destinazioni.size();
+
+    auto emit = [&]() {
+        Bozza bozza{ClasseReazione::DoppioScambio, {}, usati};
+        for (size_t k = 0; k < sorgenti.size(); k++) {
+            const Ione& catione = per_catione ? *sorgenti[k] : *destinazioni[scelta[k]];
+            const Ione& anione = per_catione ? *destinazioni[scelta[k]] : *sorgenti[k];
+            if (is_ion(catione, {"H"sv}) && is_ion(anione, {"O"sv, "H"sv})) {
+                bozza.classe = ClasseReazione::Neutralizzazione;
+            }
+            bozza.prodotti.push_back(make_salt(catione, anione));
+        }
+        bozze.push_back(std::move(bozza));
+    };
+    auto branch = [&](auto& self, size_t k) -> void {
+        if (bozze.size() >= max_bozze || sorgenti.size() - k < scoperte) return;
+        if (k == sorgenti.size()) {
+            emit();
+            return;
+        }
+        for (size_t d = 0; d < destinazioni.size(); d++) {
+            scelta[k] = d;
+            if (usi[d]++ == 0) scoperte--;
+            self(self, k + 1);
+            if (--usi[d] == 0) scoperte++;
+        }
+    };
+    branch(branch, 0);
+}
+
+static void add_single_displacement(const Specie& elemento, const Specie& composto, std::vector<Bozza>& bozze) {
+    if (!elemento.elemento.has_value() || !composto.ioni.has_value()) return;
+    auto elem = elemento.elemento.value();
+    const auto& [catione, anione] = composto.ioni.value();
+    auto catione_elem = catione.atomi[0].element;
+
+    // un metallo sposta il catione, un non metallo sposta un anione monoatomico
+    bool is_metal = elem->size_no() > 0 && states_where(elem, [](int s) { return s < 0; }).empty();
+    if (is_metal && !same_element(elem, catione_elem)) {
+        for (int q : states_where(elem, [](int s) { return s > 0; })) {
+            bozze.push_back({ClasseReazione::SempliceScambio,
+                             {make_salt(monatomic(elem, q), anione), make_elemental(catione_elem)}});
+        }
+    }
+    if (anione.atomi.size() == 1 && !same_element(elem, anione.atomi[0].element)) {
+        for (int q : states_where(elem, [](int s) { return s < 0; })) {
+            bozze.push_back({ClasseReazione::SempliceScambio,
+                             {make_salt(catione, monatomic(elem, q)), make_elemental(anione.atomi[0].element)}});
+        }
+    }
+}
+
+static void add_synthesis(const Specie& a, const Specie& b, std::vector<Bozza>& bozze) {
+    if (!a.elemento.has_value() || !b.elemento.has_value()) return;
+    auto elem_a = a.elemento.value();
+    auto elem_b = b.elemento.value();
+    if (same_element(elem_a, elem_b)) return;
+    for (int pos : states_where(elem_a, [](int s) { return s > 0; })) {
+        for (int neg : states_where(elem_b, [](int s) { return s < 0; })) {
+            bozze.push_back({ClasseReazione::Sintesi, {make_salt(monatomic(elem_a, pos), monatomic(elem_b, neg))}});
+        }
+    }
+}
+
+static void add_decomposition(const Specie& specie, std::vector<Bozza>& bozze) {
+    if (specie.elemento.has_value()) return;
+
+    Bozza elementi{ClasseReazione::Decomposizione, {}};
+    std::vector<ElementRef> visti{};
+    auto add_element = [&](ElementRef elem) {
+        if (std::ranges::any_of(visti, [&](ElementRef v) { return same_element(v, elem); })) return;
+        visti.push_back(elem);
+        elementi.prodotti.push_back(make_elemental(elem));
+    };
+    for (const auto& variant : specie.composto) {
+        if (std::holds_alternative<SingleElementQt>(variant)) {
+            add_element(std::get<SingleElementQt>(variant).element);
+        } else {
+            for (const auto& elem : std::get<GroupElementQt>(variant).group) {
+                add_element(elem.element);
+            }
+        }
+    }
+    bozze.push_back(std::move(elementi));
+
+    if (!specie.ioni.has_value()) return;
+    const auto& [catione, anione] = specie.ioni.value();
+    auto ossido_catione = make_salt(catione, monatomic(ElementRef{ossigeno}, -2));
+    if (is_ion(anione, {"O"sv, "H"sv})) {
+        // idrossido -> ossido + acqua
+        bozze.push_back(
+        {ClasseReazione::Decomposizione, {std::move(ossido_catione), make_oxide(ElementRef{idrogeno}, 1)}});
+        return;
+    }
+    // sale di un ossoanione XOn -> ossido del catione + ossido di X, se lo stato di X risultante è ammesso
+    if (anione.atomi.size() != 2 || anione.atomi[1].element->name() != "O") return;
+    auto centrale = anione.atomi[0].element;
+    int stato = 2 * static_cast<int>(anione.atomi[1].quantity) + anione.carica;
+    if (anione.atomi[0].quantity != 1 || stato <= 0 || !has_state(centrale, stato)) return;
+    bozze.push_back({ClasseReazione::Decomposizione, {std::move(ossido_catione), make_oxide(centrale, stato)}});
+}
+
+static size_t priority(ClasseReazione classe) {
+    switch (classe) {
+    case ClasseReazione::Neutralizzazione:
+    case ClasseReazione::Combustione:
+        return 0;
+    case ClasseReazione::DoppioScambio:
+    case ClasseReazione::SempliceScambio:
+    case ClasseReazione::Sintesi:
+        return 1;
+    case ClasseReazione::Decomposizione:
+        return 2;
+    }
+    return 3;
+}
+
+// chiave indipendente dall'ordine dei composti, per scartare i candidati equivalenti
+static std::string candidate_key(std::vector<std::string> formule) {
+    std::ranges::sort(formule);
+    std::string key{};
+    for (const auto& formula : formule) {
+        key += formula;
+        key += '+';
+    }
+    return key;
+}
+
+// sottoinsiemi di almeno due reagenti ionici, dal più piccolo, ognuno con i propri scambi di ioni: se si raggiunge
+// max_bozze restano fuori i sottoinsiemi più grandi, che sono anche quelli con meno probabilità di avere
+// coefficienti unici
+static void add_ion_exchanges(const std::vector<Specie>& specie, std::vector<Bozza>& bozze) {
+    std::vector<size_t> ionici{};
+    for (size_t i = 0; i < specie.size(); i++) {
+        if (specie[i].ioni.has_value()) ionici.push_back(i);
+    }
+    if (ionici.size() < 2 || ionici.size() > max_reagenti_ionici) return;
+    std::vector<unsigned> maschere(size_t{1} << ionici.size());
+    std::iota(maschere.begin(), maschere.end(), 0u);
+    std::ranges::stable_sort(maschere, {}, [](unsigned m) { return std::popcount(m); });
+    for (unsigned maschera : maschere) {
+        if (std::popcount(maschera) < 2) continue;
+        std::vector<size_t> usati{};
+        for (size_t k = 0; k < ionici.size(); k++) {
+            if (maschera & (1u << k)) usati.push_back(ionici[k]);
+        }
+        add_ion_exchange(specie, usati, bozze);
+    }
+}
+
+// i thread restano vivi tra una previsione e l'altra
+static WorkerPool& prediction_pool() {
+    static WorkerPool pool{};
+    return pool;
+}
+
+std::vector<Candidato> predict_products(const std::pmr::vector<Composto>& reagenti) {
+    std::vector<Specie> specie{};
+    for (const auto& reagente : reagenti) {
+        specie.push_back(classify(reagente));
+    }
+
+    std::vector<Bozza> bozze{};
+    if (specie.size() == 1) {
+        add_decomposition(specie[0], bozze);
+        for (auto& bozza : bozze) bozza.reagenti = {0};
+    } else {
+        add_combustion(specie, bozze);
+        add_ion_exchanges(specie, bozze);
+        // scambi semplici e sintesi avvengono tra due reagenti alla volta
+        for (size_t i = 0; i < specie.size(); i++) {
+            for (size_t j = 0; j < specie.size(); j++) {
+                if (i == j) continue;
+                size_t prima = bozze.size();
+                add_single_displacement(specie[i], specie[j], bozze);
+                add_synthesis(specie[i], specie[j], bozze);
+                for (size_t k = prima; k < bozze.size(); k++) bozze[k].reagenti = {i, j};
+            }
+        }
+    }
+
+    // un candidato è equivalente a un altro se coinvolge gli stessi reagenti e dà gli stessi prodotti;
+    // quelli i cui prodotti coincidono con i reagenti non sono reazioni
+    std::vector<std::string> formule_reagenti{};
+    for (const auto& reagente : reagenti) {
+        formule_reagenti.push_back(format_formula(reagente).toStdString());
+    }
+    std::unordered_set<std::string> visti{};
+    std::erase_if(bozze, [&](const Bozza& bozza) {
+        std::vector<std::string> formule{};
+        for (size_t i : bozza.reagenti) formule.push_back(formule_reagenti[i]);
+        auto chiave_reagenti = candidate_key(std::move(formule));
+        formule.clear();
+        for (const auto& prodotto : bozza.prodotti) formule.push_back(format_formula(prodotto).toStdString());
+        auto chiave_prodotti = candidate_key(std::move(formule));
+        return chiave_reagenti == chiave_prodotti || !visti.insert(chiave_reagenti + "->" + chiave_prodotti).second;
+    });
+
+    // il bilanciamento di ogni candidato è indipendente dagli altri, quindi si divide tra più thread
+    std::vector<std::optional<Candidato>> valutati(bozze.size());
+    auto evaluate = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Reazione reazione{};
+            for (size_t k : bozze[i].reagenti) {
+                reazione.reagenti.push_back(reagenti[k]);
+            }
+            for (auto& prodotto : bozze[i].prodotti) {
+                reazione.prodotti.push_back(std::move(prodotto));
+            }
+            auto coefficients = solve_coefficients(reazione);
+            if (!coefficients.has_value()) continue;
+            apply_coefficients(reazione, coefficients.value());
+            // a parità di classe vengono prima i candidati che usano tutti i reagenti, poi i più semplici
+            size_t esclusi = reagenti.size() - bozze[i].reagenti.size();
+            size_t somma = std::accumulate(coefficients->begin(), coefficients->end(), size_t{0});
+            size_t punteggio = priority(bozze[i].classe) * 1000 + esclusi * 100 + somma;
+            valutati[i].emplace(bozze[i].classe, std::move(reazione), punteggio);
+        }
+    };
+    constexpr size_t min_per_thread = 16;
+    prediction_pool().parallel_for(bozze.size(), min_per_thread, evaluate);
+
+    std::vector<Candidato> candidati{};
+    for (auto& candidato : valutati) {
+        if (candidato.has_value()) candidati.push_back(std::move(candidato).value());
+    }
+    std::ranges::stable_sort(candidati, {}, &Candidato::punteggio);
+    return candidati;
+}
+
+QString format_classe(ClasseReazione classe) {
+    switch (classe) {
+    case ClasseReazione::Neutralizzazione:
+        return "Neutralizzazione";
+    case ClasseReazione::Combustione:
+        return "Combustione";
+    case ClasseReazione::DoppioScambio:
+        return "Doppio scambio";
+    case ClasseReazione::SempliceScambio:
+        return "Scambio semplice";
+    case ClasseReazione::Sintesi:
+        return "Sintesi";
+    case ClasseReazione::Decomposizione:
+        return "Decomposizione";
+    }
+    return {};
+}
+
+Risultato do_predict(QStringView argument) {
+    // se c'è già una freccia si considerano solo i reagenti
+    std::pmr::vector<Composto> reagenti{};
+    if (!parse_reagents(to_u16(argument), reagenti)) return {.errore = last_error};
+
+    auto candidati = predict_products(reagenti);
+    if (candidati.empty()) {
+        error("Nessun prodotto previsto per questi reagenti");
+        return {.errore = last_error};
+    }
+
+    QString testo{"Prodotti previsti:\n"};
+    for (const auto& candidato : candidati) {
+        testo.append(QString{"[%1] %2\n"}.arg(format_classe(candidato.classe), format_equazione(candidato.reazione)));
+    }
+    return {.reazione = std::move(candidati.front().reazione), .testo = testo};
+}
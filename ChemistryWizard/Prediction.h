@@ -0,0 +1,17 @@
+#pragma once
+#include "Actions.h"
+
+enum class ClasseReazione { Neutralizzazione, Combustione, DoppioScambio, SempliceScambio, Sintesi, Decomposizione };
+
+struct Candidato {
+    ClasseReazione classe;
+    Reazione reazione;
+    // più basso è, più il candidato è probabile
+    size_t punteggio;
+};
+
+// genera i prodotti possibili per i reagenti dati, già bilanciati e ordinati per punteggio
+std::vector<Candidato> predict_products(const std::pmr::vector<Composto>& reagenti);
+QString format_classe(ClasseReazione classe);
+
+Risultato do_predict(QStringView argument);
@@ -0,0 +1,275 @@
+#include "ResultCache.h"
+#include "Actions.h"
+#include "Lexer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+
+static constexpr char cache_magic[8] = {'C', 'W', 'C', 'A', 'C', 'H', 'E', '\0'};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t engine_version;
+    uint64_t capacity;
+    uint64_t bucket_count;
+    // primo byte libero dopo l'ultimo record
+    uint64_t end;
+};
+
+struct RecordHeader {
+    uint64_t hash;
+    // record precedente nella stessa catena, 0 se è l'ultimo
+    uint64_t next;
+    uint32_t key_len;
+    uint32_t n_coefficienti;
+    uint32_t text_len;
+    uint32_t errore;
+};
+
+static constexpr uint64_t header_size = 64;
+static constexpr uint64_t buckets_offset = header_size;
+static constexpr uint64_t records_offset = buckets_offset + ResultCache::bucket_count * sizeof(uint64_t);
+static_assert(sizeof(FileHeader) <= header_size);
+
+static constexpr uint64_t align8(uint64_t v) {
+    return (v + 7) & ~uint64_t{7};
+}
+
+static uint64_t record_size(const RecordHeader& record) {
+    return sizeof(RecordHeader) + align8(record.key_len) + align8(record.n_coefficienti * sizeof(uint32_t)) +
+           align8(record.text_len);
+}
+
+static uint64_t fnv1a(std::string_view key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+std::string normalize_reaction(std::string_view reaction) {
+    // la chiave è la sequenza di token, quindi è uguale solo per testi che il parser legge allo stesso modo
+    std::string normalized{};
+    normalized.reserve(reaction.size());
+    Lexer<char> lexer{reaction};
+    TipoToken previous = TipoToken::Fine;
+    for (Token tok = lexer.next(); tok.tipo != TipoToken::Fine; previous = tok.tipo, tok = lexer.next()) {
+        bool after_number = previous == TipoToken::Numero || previous == TipoToken::Pedice;
+        switch (tok.tipo) {
+        case TipoToken::Elemento:
+            normalized.append(tok.simbolo, tok.simbolo[1] == '\0' ? 1 : 2);
+            break;
+        case TipoToken::Numero:
+        case TipoToken::Pedice:
+            if (after_number) normalized += ' ';
+            // un pedice vale come un numero solo dopo un elemento o un gruppo, altrove il parser li distingue
+            if (tok.tipo == TipoToken::Pedice && previous != TipoToken::Elemento &&
+                previous != TipoToken::ChiusaParentesi) {
+                normalized += '_';
+            }
+            normalized += std::to_string(tok.valore);
+            break;
+        case TipoToken::Carica: {
+            long long valore = tok.valore < 0 ? -tok.valore : tok.valore;
+            normalized += '^' + std::to_string(valore) + (tok.valore < 0 ? '-' : '+');
+            break;
+        }
+        case TipoToken::ApertaParentesi:
+            normalized += '(';
+            break;
+        case TipoToken::ChiusaParentesi:
+            normalized += ')';
+            break;
+        case TipoToken::Piu:
+            normalized += '+';
+            break;
+        case TipoToken::Freccia:
+            normalized += "->";
+            break;
+        case TipoToken::Idrato:
+            normalized += '*';
+            break;
+        default:
+            // il messaggio d'errore riporta il carattere, che quindi resta nella chiave
+            normalized += '<' + std::to_string(tok.valore) + '>';
+            break;
+        }
+    }
+    return normalized;
+}
+
+ResultCache::ResultCache(const QString& path, uint64_t capacity) : m_file(path), m_lock(path + ".lock") {
+    m_lock.setStaleLockTime(0);
+    m_writable = m_lock.tryLock(0);
+    if (m_writable) {
+        if (!m_file.open(QIODevice::ReadWrite)) {
+            m_writable = false;
+            return;
+        }
+        // un file vuoto, di un'altra versione o corrotto viene ricreato da zero
+        if (static_cast<uint64_t>(m_file.size()) < records_offset || !(m_map = m_file.map(0, m_file.size())) ||
+            !valid_header()) {
+            if (m_map != nullptr) m_file.unmap(m_map);
+            m_map = nullptr;
+            if (!init_file(std::max(capacity, records_offset))) m_writable = false;
+        }
+    } else {
+        if (!m_file.open(QIODevice::ReadOnly)) return;
+        if (static_cast<uint64_t>(m_file.size()) < records_offset) return;
+        m_map = m_file.map(0, m_file.size());
+        if (m_map != nullptr && !valid_header()) {
+            m_file.unmap(m_map);
+            m_map = nullptr;
+        }
+    }
+}
+
+ResultCache::~ResultCache() {
+    if (m_map != nullptr) m_file.unmap(m_map);
+    if (m_writable) m_lock.unlock();
+}
+
+bool ResultCache::init_file(uint64_t capacity) {
+    // il file viene preparato con un altro nome e poi sostituito a quello vecchio: i lettori che lo hanno ancora
+    // mappato continuano a vedere il vecchio contenuto invece di ricevere SIGBUS per un file troncato
+    m_file.close();
+    QFile temp{m_file.fileName() + ".tmp"};
+    // la dimensione non cambia più dopo la creazione, così i lettori non devono mai rimappare il file
+    if (!temp.open(QIODevice::ReadWrite | QIODevice::Truncate) || !temp.resize(static_cast<qint64>(capacity))) {
+        return false;
+    }
+    uchar* map = temp.map(0, static_cast<qint64>(capacity));
+    if (map == nullptr) return false;
+    std::memset(map, 0, records_offset);
+    FileHeader header{};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.format_version = format_version;
+    header.engine_version = engine_version;
+    header.capacity = capacity;
+    header.bucket_count = bucket_count;
+    header.end = records_offset;
+    std::memcpy(map, &header, sizeof(header));
+    temp.unmap(map);
+    temp.close();
+
+    std::error_code ec{};
+    std::filesystem::rename(temp.fileName().toStdU16String(), m_file.fileName().toStdU16String(), ec);
+    if (ec) {
+        temp.remove();
+        return false;
+    }
+    if (!m_file.open(QIODevice::ReadWrite)) return false;
+    m_map = m_file.map(0, static_cast<qint64>(capacity));
+    return m_map != nullptr;
+}
+
+bool ResultCache::valid_header() const {
+    const auto* header = reinterpret_cast<const FileHeader*>(m_map);
+    return std::memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 &&
+           header->format_version == format_version && header->engine_version == engine_version &&
+           header->bucket_count == bucket_count && header->capacity == static_cast<uint64_t>(m_file.size());
+}
+
+std::optional<VoceCache> ResultCache::find(std::string_view key) const {
+    if (m_map == nullptr) return {};
+    const auto* header = reinterpret_cast<const FileHeader*>(m_map);
+    uint64_t hash = fnv1a(key);
+    auto& bucket = reinterpret_cast<uint64_t*>(m_map + buckets_offset)[hash % bucket_count];
+    uint64_t offset = std::atomic_ref<uint64_t>{bucket}.load(std::memory_order_acquire);
+    while (offset != 0 && offset + sizeof(RecordHeader) <= header->capacity) {
+        const auto* record = reinterpret_cast<const RecordHeader*>(m_map + offset);
+        if (offset + record_size(*record) > header->capacity) return {};
+        const char* data = reinterpret_cast<const char*>(record + 1);
+        if (record->hash == hash && std::string_view{data, record->key_len} == key) {
+            VoceCache voce{};
+            data += align8(record->key_len);
+            voce.coefficienti.resize(record->n_coefficienti);
+            if (record->n_coefficienti > 0) {
+                std::memcpy(voce.coefficienti.data(), data, record->n_coefficienti * sizeof(uint32_t));
+            }
+            data += align8(record->n_coefficienti * sizeof(uint32_t));
+            voce.testo.assign(data, record->text_len);
+            voce.errore = record->errore != 0;
+            return voce;
+        }
+        // i record puntano sempre a record precedenti, quindi una catena corrotta non può ciclare
+        offset = record->next < offset ? record->next : 0;
+    }
+    return {};
+}
+
+bool ResultCache::insert(std::string_view key, const VoceCache& voce) {
+    if (!m_writable || m_map == nullptr) return false;
+    auto* header = reinterpret_cast<FileHeader*>(m_map);
+    uint64_t hash = fnv1a(key);
+    auto& bucket = reinterpret_cast<uint64_t*>(m_map + buckets_offset)[hash % bucket_count];
+    RecordHeader record{.hash = hash,
+                        .next = bucket,
+                        .key_len = static_cast<uint32_t>(key.size()),
+                        .n_coefficienti = static_cast<uint32_t>(voce.coefficienti.size()),
+                        .text_len = static_cast<uint32_t>(voce.testo.size()),
+                        .errore = voce.errore ? 1u : 0u};
+    uint64_t coefficients_size = voce.coefficienti.size() * sizeof(uint32_t);
+    uint64_t size = record_size(record);
+    uint64_t offset = header->end;
+    if (offset + size > header->capacity) {
+        // file pieno: si ricomincia con una nuova generazione vuota della stessa dimensione
+        uint64_t capacity = header->capacity;
+        if (records_offset + size > capacity) return false;
+        m_file.unmap(m_map);
+        m_map = nullptr;
+        if (!init_file(capacity)) {
+            std::fprintf(stderr, "Impossibile ricreare la cache piena %s\n", qPrintable(m_file.fileName()));
+            m_writable = false;
+            return false;
+        }
+        return insert(key, voce);
+    }
+
+    uchar* data = m_map + offset;
+    std::memcpy(data, &record, sizeof(record));
+    data += sizeof(record);
+    std::memcpy(data, key.data(), key.size());
+    data += align8(key.size());
+    if (coefficients_size > 0) std::memcpy(data, voce.coefficienti.data(), coefficients_size);
+    data += align8(coefficients_size);
+    std::memcpy(data, voce.testo.data(), voce.testo.size());
+
+    // il record è completo: ora si può pubblicare
+    std::atomic_ref<uint64_t>{header->end}.store(offset + size, std::memory_order_release);
+    std::atomic_ref<uint64_t>{bucket}.store(offset, std::memory_order_release);
+    return true;
+}
+
+VoceCache cached_balance(ResultCache* cache, const std::string& reaction) {
+    auto key = normalize_reaction(reaction);
+    if (cache != nullptr) {
+        if (auto voce = cache->find(key); voce.has_value()) return std::move(voce).value();
+    }
+
+    auto risultato = balance_equation(reaction);
+    VoceCache voce{};
+    if (!risultato.ok()) {
+        voce.errore = true;
+        voce.testo = risultato.errore.toStdString();
+    } else {
+        const auto& r = risultato.reazione.value();
+        for (const auto& composto : r.reagenti) {
+            voce.coefficienti.push_back(static_cast<uint32_t>(composto.quantity()));
+        }
+        for (const auto& composto : r.prodotti) {
+            voce.coefficienti.push_back(static_cast<uint32_t>(composto.quantity()));
+        }
+        // la reazione è valida ma senza coefficienti unici: si salva comunque l'avviso
+        voce.errore = !risultato.testo.isEmpty();
+        voce.testo = voce.errore ? risultato.testo.trimmed().toStdString() : format_equazione(r).toStdString();
+    }
+    if (cache != nullptr) cache->insert(key, voce);
+    return voce;
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <QFile>
+#include <QLockFile>
+
+struct VoceCache {
+    std::vector<uint32_t> coefficienti{};
+    // equazione bilanciata oppure messaggio d'errore, in UTF-8
+    std::string testo{};
+    bool errore = false;
+};
+
+// cache persistente dei risultati di do_balance: un file mappato in memoria con una tabella hash a catene,
+// in cui i record vengono solo aggiunti in coda. Lo scrittore è uno solo (protetto da un lock file),
+// i lettori possono essere più processi insieme: un record diventa visibile solo quando la testa della
+// sua catena viene aggiornata, dopo che è stato scritto per intero.
+class ResultCache {
+    QFile m_file;
+    QLockFile m_lock;
+    uchar* m_map = nullptr;
+    bool m_writable = false;
+
+    bool init_file(uint64_t capacity);
+    bool valid_header() const;
+
+    public:
+    static constexpr uint32_t format_version = 2;
+    // da incrementare ogni volta che il motore di bilanciamento cambia i risultati, per invalidare la cache
+    static constexpr uint32_t engine_version = 2;
+    static constexpr uint64_t default_capacity = 64ull << 20;
+    static constexpr uint64_t bucket_count = 1ull << 16;
+
+    explicit ResultCache(const QString& path, uint64_t capacity = default_capacity);
+    ~ResultCache();
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    bool is_open() const { return m_map != nullptr; }
+    bool is_writable() const { return m_writable; }
+    std::optional<VoceCache> find(std::string_view key) const;
+    // quando il file è pieno i record vecchi vengono scartati ricreandolo vuoto, come per una versione diversa.
+    // false se la cache è di sola lettura o se il record non entra neanche in un file vuoto
+    bool insert(std::string_view key, const VoceCache& voce);
+};
+
+// chiave costruita dai token della reazione, così `2H2 + O2 -> 2H2O`, `2H2+O2->2H2O` e `2H₂ + O₂ → 2H₂O`
+// (anche con spazi non separabili) hanno la stessa chiave
+std::string normalize_reaction(std::string_view reaction);
+
+// bilancia la reazione passando prima dalla cache, se presente; i risultati nuovi vengono aggiunti
+VoceCache cached_balance(ResultCache* cache, const std::string& reaction);
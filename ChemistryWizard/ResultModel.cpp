@@ -0,0 +1,135 @@
+#include "ResultModel.h"
+
+// gli indici di primo livello hanno internalId 0, quelli dei composti la riga della reazione + 1
+static constexpr quintptr top_level_id = 0;
+
+RigaRisultato make_riga(QString input, const Risultato& risultato) {
+    RigaRisultato riga{.input = std::move(input), .errore = risultato.errore, .dettaglio = format_risultato(risultato)};
+    if (risultato.reazione.has_value()) {
+        const auto& reazione = risultato.reazione.value();
+        riga.massa = reazione.molecular_mass();
+        riga.composti.reserve(reazione.reagenti.size() + reazione.prodotti.size());
+        auto add = [&](const Composto& composto, bool reagente) {
+            riga.composti.push_back(
+            {format_formula(composto), format_composto(composto), composto.molecular_mass(), reagente});
+        };
+        for (const auto& reagente : reazione.reagenti) add(reagente, true);
+        for (const auto& prodotto : reazione.prodotti) add(prodotto, false);
+    }
+    return riga;
+}
+
+uint64_t ResultModel::reset() {
+    beginResetModel();
+    m_righe.clear();
+    m_righe.shrink_to_fit();
+    m_generazione++;
+    endResetModel();
+    return m_generazione;
+}
+
+void ResultModel::append_results(uint64_t generazione, std::vector<RigaRisultato>&& righe) {
+    if (generazione != m_generazione || righe.empty()) return;
+    int first = static_cast<int>(m_righe.size());
+    beginInsertRows({}, first, first + static_cast<int>(righe.size()) - 1);
+    m_righe.insert(m_righe.end(), std::make_move_iterator(righe.begin()), std::make_move_iterator(righe.end()));
+    endInsertRows();
+}
+
+QModelIndex ResultModel::index(int row, int column, const QModelIndex& parent) const {
+    if (!hasIndex(row, column, parent)) return {};
+    if (!parent.isValid()) return createIndex(row, column, top_level_id);
+    return createIndex(row, column, static_cast<quintptr>(parent.row()) + 1);
+}
+
+QModelIndex ResultModel::parent(const QModelIndex& child) const {
+    if (!child.isValid() || child.internalId() == top_level_id) return {};
+    return createIndex(static_cast<int>(child.internalId() - 1), 0, top_level_id);
+}
+
+int ResultModel::rowCount(const QModelIndex& parent) const {
+    if (!parent.isValid()) return static_cast<int>(m_righe.size());
+    if (parent.internalId() != top_level_id || parent.column() != 0) return 0;
+    return static_cast<int>(m_righe[parent.row()].composti.size());
+}
+
+int ResultModel::columnCount(const QModelIndex&) const {
+    return Colonna::__SIZE__;
+}
+
+bool ResultModel::hasChildren(const QModelIndex& parent) const {
+    return rowCount(parent) > 0;
+}
+
+QVariant ResultModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid()) return {};
+
+    if (index.internalId() == top_level_id) {
+        const auto& riga = m_righe[index.row()];
+        bool ok = riga.errore.isEmpty();
+        if (role == ErrorRole) return !ok;
+        switch (index.column()) {
+        case Colonna::Testo:
+            if (role == Qt::DisplayRole || role == SortRole) return riga.input;
+            if (role == Qt::ToolTipRole) return riga.dettaglio;
+            break;
+        case Colonna::Stato:
+            if (role == Qt::DisplayRole || role == SortRole) return ok ? QString{"OK"} : riga.errore;
+            break;
+        case Colonna::Massa:
+            if (riga.massa < 0.0) return role == SortRole ? QVariant{-1.0} : QVariant{};
+            if (role == Qt::DisplayRole || role == SortRole) return riga.massa;
+            break;
+        default:
+            break;
+        }
+        return {};
+    }
+
+    const auto& composto = m_righe[index.internalId() - 1].composti[index.row()];
+    if (role == ErrorRole) return false;
+    switch (index.column()) {
+    case Colonna::Testo:
+        if (role == Qt::DisplayRole) return composto.formula;
+        if (role == SortRole) return index.row();
+        if (role == Qt::ToolTipRole) return composto.dettaglio;
+        break;
+    case Colonna::Stato:
+        if (role == Qt::DisplayRole || role == SortRole) {
+            return composto.reagente ? QString{"Reagente"} : QString{"Prodotto"};
+        }
+        break;
+    case Colonna::Massa:
+        if (role == Qt::DisplayRole || role == SortRole) return composto.massa;
+        break;
+    default:
+        break;
+    }
+    return {};
+}
+
+QVariant ResultModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) return {};
+    switch (section) {
+    case Colonna::Testo:
+        return QString{"Reazione"};
+    case Colonna::Stato:
+        return QString{"Esito"};
+    case Colonna::Massa:
+        return QString{"Massa molecolare"};
+    default:
+        return {};
+    }
+}
+
+void ResultFilterModel::set_filter(Filtro filtro) {
+    m_filtro = filtro;
+    invalidateFilter();
+}
+
+bool ResultFilterModel::filterAcceptsRow(int source_row, const QModelIndex& source_parent) const {
+    // i composti seguono sempre la loro reazione
+    if (source_parent.isValid() || m_filtro == Filtro::Tutti) return true;
+    bool is_error = sourceModel()->index(source_row, 0, source_parent).data(ResultModel::ErrorRole).toBool();
+    return m_filtro == Filtro::Errori ? is_error : !is_error;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include "Actions.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <QAbstractItemModel>
+#include <QSortFilterProxyModel>
+
+// composto di una riga, già formattato dal thread che ha valutato la riga
+struct ComponenteRiga {
+    QString formula;
+    QString dettaglio;
+    double massa;
+    bool reagente;
+};
+
+// la reazione analizzata non viene tenuta: il thread di valutazione ne prepara una volta sola i testi che la view
+// può chiedere, così il thread della UI non deve mai rieseguire i motori
+struct RigaRisultato {
+    QString input;
+    // vuoto se la riga è valida
+    QString errore{};
+    // massa molecolare dei reagenti, negativa se il risultato non ha una reazione
+    double massa = -1.0;
+    // testo completo del risultato, mostrato come tooltip
+    QString dettaglio{};
+    std::vector<ComponenteRiga> composti{};
+};
+
+RigaRisultato make_riga(QString input, const Risultato& risultato);
+
+// una riga per reazione, con i composti come figli
+class ResultModel : public QAbstractItemModel {
+    Q_OBJECT
+
+    std::vector<RigaRisultato> m_righe{};
+    // incrementata a ogni reset, per scartare le righe in arrivo da una valutazione precedente
+    uint64_t m_generazione = 0;
+
+    public:
+    enum Colonna { Testo, Stato, Massa, __SIZE__ };
+    static constexpr int SortRole = Qt::UserRole;
+    static constexpr int ErrorRole = Qt::UserRole + 1;
+
+    ResultModel(QObject* parent = nullptr) : QAbstractItemModel(parent) {}
+
+    // svuota il modello per una nuova valutazione e ne restituisce la generazione
+    uint64_t reset();
+    void append_results(uint64_t generazione, std::vector<RigaRisultato>&& righe);
+
+    QModelIndex index(int row, int column, const QModelIndex& parent = {}) const override;
+    QModelIndex parent(const QModelIndex& child) const override;
+    int rowCount(const QModelIndex& parent = {}) const override;
+    int columnCount(const QModelIndex& parent = {}) const override;
+    bool hasChildren(const QModelIndex& parent = {}) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+};
+
+class ResultFilterModel : public QSortFilterProxyModel {
+    Q_OBJECT
+
+    public:
+    enum class Filtro { Tutti, Validi, Errori };
+
+    private:
+    Filtro m_filtro = Filtro::Tutti;
+
+    public:
+    ResultFilterModel(QObject* parent = nullptr) : QSortFilterProxyModel(parent) { setSortRole(ResultModel::SortRole); }
+
+    void set_filter(Filtro filtro);
+
+    protected:
+    bool filterAcceptsRow(int source_row, const QModelIndex& source_parent) const override;
+};
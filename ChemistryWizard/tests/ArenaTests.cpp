@@ -0,0 +1,40 @@
+// ogni reazione letta da balance_equation deve stare in un solo blocco dell'arena
+#include "Check.h"
+#include "Actions.h"
+
+#include <string>
+
+static size_t allocations(const std::string& equation) {
+    auto risultato = balance_equation(std::string_view{equation});
+    CHECK(risultato.ok() && risultato.reazione.has_value());
+    return risultato.reazione.has_value() ? risultato.reazione->allocations() : 0;
+}
+
+TEST_CASE(arena_single_block) {
+    CHECK(allocations("H2 + O2 -> H2O") == 1);
+    CHECK(allocations("Ca3(PO4)2 + H2SO4 -> CaSO4 + H3PO4") == 1);
+    CHECK(allocations("K4[Fe(CN)6] + KMnO4 + H2SO4 -> KHSO4 + Fe2(SO4)3 + MnSO4 + HNO3 + CO2 + H2O") == 1);
+    CHECK(allocations("Mg(((OH)2)3)4 -> MgO + H2O") == 1);
+    CHECK(allocations("CuSO4·5H2O -> CuSO4 + H2O") == 1);
+    CHECK(allocations("CuSO₄·5H₂O → CuSO₄ + H₂O") == 1);
+    CHECK(allocations("Na2CO3*10H2O*2NaCl -> Na2CO3 + H2O + NaCl") == 1);
+    CHECK(allocations("C6H12O6 + O2 -> CO2 + H2O") == 1);
+    CHECK(allocations("MnO4^- + Fe^2+ + H^+ -> Mn^2+ + Fe^3+ + H2O") == 1);
+}
+
+TEST_CASE(arena_many_compounds) {
+    // i vettori crescono per raddoppi: si provano lati appena oltre una potenza di due
+    for (size_t n : {3, 5, 9, 17, 33, 65}) {
+        std::string equation{};
+        for (size_t i = 0; i < n; i++) equation += i == 0 ? "H2" : " + H2";
+        equation += " -> ";
+        for (size_t i = 0; i < n; i++) equation += i == 0 ? "H" : " + H";
+        auto risultato = balance_equation(std::string_view{equation});
+        CHECK(risultato.ok() && risultato.reazione.has_value());
+        if (risultato.reazione.has_value()) CHECK(risultato.reazione->allocations() == 1);
+
+        std::string groups{"Ca3"};
+        for (size_t i = 0; i < n; i++) groups += "(PO4)(OH)";
+        CHECK(allocations(groups + " -> Ca + P + O + H") == 1);
+    }
+}
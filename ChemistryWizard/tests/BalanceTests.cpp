@@ -0,0 +1,69 @@
+// coefficienti, coefficienti scritti dall'utente e predizione dei prodotti
+#include "Check.h"
+#include "Actions.h"
+#include "Prediction.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+TEST_CASE(solve) {
+    auto risultato = balance_equation(std::string_view{"Ca3(PO4)2 + H2SO4 -> CaSO4 + H3PO4"});
+    CHECK(risultato.reazione.has_value());
+    if (risultato.reazione.has_value()) {
+        auto coefficients = solve_coefficients(risultato.reazione.value());
+        CHECK((coefficients == std::vector<size_t>{1, 3, 3, 2}));
+    }
+    // due reazioni indipendenti nella stessa equazione: i coefficienti non sono unici
+    auto ambigua = balance_equation(std::string_view{"H2 + O2 -> H2O + H2O2"});
+    CHECK(ambigua.ok() && ambigua.reazione.has_value() && !ambigua.testo.isEmpty());
+    if (ambigua.reazione.has_value()) CHECK(!solve_coefficients(ambigua.reazione.value()).has_value());
+}
+
+TEST_CASE(solve_overflow) {
+    // ogni numero sta nel limite del lexer, ma l'eliminazione supera un long long
+    auto risultato = balance_equation(std::string_view{
+    "C999999937H999999929 + O999999893 -> C999999883O999999877 + H999999866O999999853"});
+    CHECK(risultato.errore.toStdString() == "Numeri troppo grandi nella reazione");
+}
+
+TEST_CASE(written_coefficients) {
+    // coefficienti scritti e corretti: si tengono anche se non sono i minimi
+    auto giusti = balance_equation(std::string_view{"4H2 + 2O2 -> 4H2O"});
+    CHECK(giusti.ok() && giusti.testo.isEmpty() && giusti.reazione.has_value());
+    if (giusti.reazione.has_value()) {
+        CHECK(format_equazione(giusti.reazione.value()).toStdString() == "4H2 + 2O2 -> 4H2O");
+    }
+    // vale anche senza una soluzione unica
+    auto ambigua = balance_equation(std::string_view{"3H2 + 2O2 -> 2H2O + H2O2"});
+    CHECK(ambigua.ok() && ambigua.testo.isEmpty());
+
+    auto sbagliati = balance_equation(std::string_view{"2H2 + 2O2 -> 2H2O"});
+    CHECK(sbagliati.errore.toStdString() ==
+          "I coefficienti scritti non bilanciano la reazione, quella corretta è: 2H2 + O2 -> 2H2O");
+    // senza coefficienti si bilancia come prima
+    CHECK(balance_equation(std::string_view{"H2 + O2 -> H2O"}).ok());
+}
+
+TEST_CASE(prediction) {
+    std::pmr::vector<Composto> reagenti{};
+    CHECK(parse_reagents(std::string_view{"HCl + NaOH"}, reagenti));
+    auto candidati = predict_products(reagenti);
+    CHECK(!candidati.empty());
+    if (!candidati.empty()) {
+        CHECK(candidati.front().classe == ClasseReazione::Neutralizzazione);
+        CHECK(format_equazione(candidati.front().reazione).toStdString() == "HCl + NaOH -> H2O + NaCl");
+    }
+
+    // scambi tra più di due reagenti e tra ogni coppia
+    reagenti.clear();
+    CHECK(parse_reagents(std::string_view{"AgNO3 + NaCl + KBr"}, reagenti));
+    std::vector<std::string> equazioni{};
+    for (const auto& candidato : predict_products(reagenti)) {
+        equazioni.push_back(format_equazione(candidato.reazione).toStdString());
+    }
+    auto has = [&](std::string_view equazione) { return std::ranges::find(equazioni, equazione) != equazioni.end(); };
+    CHECK(has("AgNO3 + NaCl + KBr -> AgCl + NaBr + KNO3"));
+    CHECK(has("AgNO3 + NaCl -> AgCl + NaNO3"));
+    CHECK(has("NaCl + KBr -> NaBr + KCl"));
+}
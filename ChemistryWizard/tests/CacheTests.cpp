@@ -0,0 +1,124 @@
+// formato del file della cache, chiavi normalizzate e ricreazione quando il file è pieno
+#include "Check.h"
+#include "ResultCache.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+template <typename T>
+static T read_le(const std::string& data, size_t offset) {
+    T value{};
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+}
+
+static std::filesystem::path cache_path(const char* name) {
+    auto path = std::filesystem::temp_directory_path() / name;
+    std::filesystem::remove(path);
+    return path;
+}
+
+static void remove_cache(const std::filesystem::path& path) {
+    CHECK(!std::filesystem::exists(path.string() + ".tmp"));
+    std::filesystem::remove(path);
+    std::filesystem::remove(path.string() + ".lock");
+}
+
+TEST_CASE(cache_keys) {
+    auto key = normalize_reaction("2H2 + O2 -> 2H2O");
+    CHECK(key == "2H2+O2->2H2O");
+    CHECK(normalize_reaction("2 H2+O2->2 H2O") == key);
+    CHECK(normalize_reaction("2H₂ + O₂ → 2H₂O") == key);
+    CHECK(normalize_reaction("2H2 + O2  -> 2H2O") == key);
+    CHECK(normalize_reaction("CuSO₄·5H₂O ⟶ CuSO₄ + 5H₂O") ==
+          normalize_reaction("CuSO4*5H2O -> CuSO4 + 5H2O"));
+    CHECK(normalize_reaction("Fe³⁺ + Cu → Fe²⁺ + Cu²⁺") ==
+          normalize_reaction("Fe^3+ + Cu -> Fe^2+ + Cu^2+"));
+    CHECK(normalize_reaction("[Fe(CN)6]^4-") == normalize_reaction("(Fe(CN)6)^4-"));
+
+    // testi che il parser legge in modo diverso restano distinti
+    CHECK(normalize_reaction("H2 3O") != normalize_reaction("H23O"));
+    CHECK(normalize_reaction("₂H2 -> H2") != normalize_reaction("2H2 -> H2"));
+    CHECK(normalize_reaction("CuSO4*₅H2O") != normalize_reaction("CuSO4*5H2O"));
+    CHECK(normalize_reaction("Co -> CO") != normalize_reaction("CO -> Co"));
+    CHECK(normalize_reaction("H2 + O2 -> H2O!") != normalize_reaction("H2 + O2 -> H2O?"));
+}
+
+TEST_CASE(cache_format) {
+    auto path = cache_path("ChemistryWizardTests.cache");
+    auto qpath = QString::fromStdString(path.string());
+    constexpr uint64_t capacity = 1 << 20;
+
+    auto key = normalize_reaction("2 H2 + O2 -> 2 H2O");
+    VoceCache voce{.coefficienti = {2, 1, 2}, .testo = "2H2 + O2 -> 2H2O", .errore = false};
+    {
+        ResultCache scrittore{qpath, capacity};
+        CHECK(scrittore.is_open() && scrittore.is_writable());
+        CHECK(scrittore.insert(key, voce));
+        CHECK(!scrittore.find("H2+O2->H2O").has_value());
+
+        // il lettore vede i record già pubblicati mentre lo scrittore tiene il lock
+        ResultCache lettore{qpath};
+        CHECK(lettore.is_open() && !lettore.is_writable());
+        auto trovata = lettore.find(key);
+        CHECK(trovata.has_value());
+        if (trovata.has_value()) {
+            CHECK(trovata->coefficienti == voce.coefficienti && trovata->testo == voce.testo && !trovata->errore);
+        }
+    }
+
+    std::string data{};
+    {
+        std::ifstream file{path, std::ios::binary};
+        data.assign(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+    }
+    CHECK(data.size() == capacity);
+    CHECK(std::memcmp(data.data(), "CWCACHE", 8) == 0);
+    CHECK(read_le<uint32_t>(data, 8) == ResultCache::format_version);
+    CHECK(read_le<uint32_t>(data, 12) == ResultCache::engine_version);
+    CHECK(read_le<uint64_t>(data, 16) == capacity);
+    CHECK(read_le<uint64_t>(data, 24) == ResultCache::bucket_count);
+
+    // un file scritto da un'altra versione del motore viene ricreato vuoto
+    {
+        std::fstream file{path, std::ios::binary | std::ios::in | std::ios::out};
+        uint32_t vecchia = ResultCache::engine_version - 1;
+        file.seekp(12);
+        file.write(reinterpret_cast<const char*>(&vecchia), sizeof(vecchia));
+    }
+    {
+        ResultCache scrittore{qpath, capacity};
+        CHECK(scrittore.is_writable() && !scrittore.find(key).has_value());
+        auto calcolata = cached_balance(&scrittore, "H2 + O2 -> H2O");
+        CHECK(!calcolata.errore && calcolata.testo == "2H2 + O2 -> 2H2O");
+        CHECK(scrittore.find(normalize_reaction("H₂ + O₂ → H₂O")).has_value());
+    }
+    remove_cache(path);
+}
+
+TEST_CASE(cache_full) {
+    auto path = cache_path("ChemistryWizardTestsFull.cache");
+    auto qpath = QString::fromStdString(path.string());
+    // la tabella dei bucket occupa 512 KiB, restano 64 KiB per i record
+    constexpr uint64_t capacity = (1 << 19) + (1 << 16);
+
+    {
+        ResultCache scrittore{qpath, capacity};
+        CHECK(scrittore.is_writable());
+        VoceCache voce{.coefficienti = {1, 1}, .testo = std::string(1000, 'x'), .errore = false};
+        for (int i = 0; i < 200; i++) CHECK(scrittore.insert("chiave" + std::to_string(i), voce));
+        // le prime chiavi sono state scartate con la generazione piena, le ultime ci sono ancora
+        CHECK(!scrittore.find("chiave0").has_value());
+        CHECK(scrittore.find("chiave199").has_value());
+        CHECK(std::filesystem::file_size(path) == capacity);
+
+        // un record più grande del file intero non può entrare in nessuna generazione
+        VoceCache enorme{.testo = std::string(capacity, 'x')};
+        CHECK(!scrittore.insert("enorme", enorme));
+        CHECK(scrittore.find("chiave199").has_value());
+    }
+    remove_cache(path);
+}
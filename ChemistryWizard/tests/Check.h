@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdio>
+#include <vector>
+
+// ogni file di test registra i propri casi con TEST_CASE; TestMain li esegue tutti e conta i controlli falliti
+inline int failures = 0;
+
+struct CasoDiTest {
+    const char* name;
+    void (*fn)();
+};
+
+inline std::vector<CasoDiTest>& test_cases() {
+    static std::vector<CasoDiTest> cases{};
+    return cases;
+}
+
+struct RegistraTest {
+    RegistraTest(const char* name, void (*fn)()) { test_cases().push_back({name, fn}); }
+};
+
+#define TEST_CASE(name)                                                                                                \
+    static void name();                                                                                                \
+    static RegistraTest name##_registrato{#name, &name};                                                               \
+    static void name()
+
+#define CHECK(cond)                                                                                                    \
+    do {                                                                                                               \
+        if (!(cond)) {                                                                                                 \
+            std::fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);                                            \
+            failures++;                                                                                                \
+        }                                                                                                              \
+    } while (false)
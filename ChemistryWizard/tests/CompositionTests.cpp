@@ -0,0 +1,70 @@
+// formula empirica e molecolare dalla composizione percentuale
+#include "Check.h"
+#include "Composition.h"
+
+#include <numeric>
+#include <set>
+#include <string>
+
+static std::vector<FormulaCandidata> infer(std::string_view text, double tolleranza = 0.5, size_t max_candidati = 5) {
+    Campione campione{};
+    CHECK(parse_campione(text, campione));
+    return infer_formula(campione, tolleranza, max_candidati);
+}
+
+static std::string best(std::string_view text) {
+    auto candidati = infer(text);
+    return candidati.empty() ? std::string{} : format_candidata(candidati.front()).toStdString();
+}
+
+TEST_CASE(composition_best_formula) {
+    CHECK(best("C 40.0%, H 6.7%, O 53.3%; M = 180.16") == "CH2O x 6 = C6H12O6 (scarto 0.01 punti, massa 180.16)");
+    CHECK(best("C 40,0 H 6,7 O 53,3") == "CH2O (scarto 0.01 punti)");
+    CHECK(best("C 92.3 H 7.7; M 78.11") == "CH x 6 = C6H6 (scarto 0.04 punti, massa 78.11)");
+    CHECK(best("H 11.19 O 88.81") == "H2O (scarto 0.00 punti)");
+    CHECK(best("Na 39.34 Cl 60.66") == "ClNa (scarto 0.00 punti)");
+}
+
+TEST_CASE(composition_search) {
+    // con una tolleranza larga la ricerca trova molte formule: nessuna ripetuta, tutte ridotte e nei limiti
+    auto candidati = infer("C 40.0 H 6.7 O 53.3", 2.0, 1000);
+    CHECK(candidati.size() > 5);
+    std::set<std::vector<size_t>> viste{};
+    for (const auto& candidata : candidati) {
+        std::vector<size_t> atomi{};
+        size_t g = 0;
+        for (const auto& [elemento, quantity] : candidata.empirica) {
+            atomi.push_back(quantity);
+            g = std::gcd(g, quantity);
+            CHECK(quantity >= 1 && quantity <= 60);
+        }
+        CHECK(g == 1);
+        CHECK(candidata.errore <= 2.0);
+        CHECK(viste.insert(atomi).second);
+    }
+    // a scarto simile vince la formula più semplice
+    CHECK(!candidati.empty() && format_candidata(candidati.front()).toStdString() == "CH2O (scarto 0.01 punti)");
+
+    // la massa molare scarta i candidati il cui multiplo non la raggiunge entro il 2%
+    for (const auto& candidata : infer("C 40.0 H 6.7 O 53.3; M 180.16", 2.0, 1000)) {
+        CHECK(candidata.errore_massa <= 0.02);
+    }
+}
+
+TEST_CASE(composition_errors) {
+    Campione campione{};
+    CHECK(parse_campione(std::string_view{"C 40 H 6.7 O 40"}, campione));
+    last_error.clear();
+    CHECK(infer_formula(campione).empty());
+    CHECK(last_error.toStdString() == "La somma delle percentuali e' 86.7, troppo lontana da 100");
+    CHECK(do_formula(QString{"C 40 H 6.7 O 40"}).errore.toStdString() ==
+          "La somma delle percentuali e' 86.7, troppo lontana da 100");
+    CHECK(do_formula(QString{"C 40 Xx 60"}).errore.toStdString().starts_with("Elemento non valido Xx"));
+    CHECK(do_formula(QString{"C 40 C 60"}).errore.toStdString() == "Elemento C ripetuto");
+
+    auto risultato = do_formula(QString{"C 40.0, H 6.7, O 53.3; M = 180.16"});
+    CHECK(risultato.ok() && risultato.reazione.has_value());
+    if (risultato.reazione.has_value()) {
+        CHECK(format_formula(risultato.reazione->reagenti.front()).toStdString() == "C6H12O6");
+    }
+}
@@ -0,0 +1,212 @@
+// demone: framing, batch, socket rimasti da esecuzioni precedenti e uscita con SIGTERM
+#include "Check.h"
+#include "Daemon.h"
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+struct Risposta {
+    uint32_t id = 0;
+    uint16_t esito = 0;
+    std::string testo{};
+};
+
+std::string socket_path() {
+    auto path = std::filesystem::temp_directory_path() / ("cw-test-" + std::to_string(getpid()) + ".sock");
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+sockaddr_un address(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    return addr;
+}
+
+int connect_to(const std::string& path) {
+    auto addr = address(path);
+    for (int tentativi = 0; tentativi < 500; tentativi++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) return fd;
+        close(fd);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return -1;
+}
+
+std::string richiesta(uint32_t id, Operazione operazione, std::string_view testo, uint32_t lunghezza = UINT32_MAX) {
+    if (lunghezza == UINT32_MAX) lunghezza = static_cast<uint32_t>(testo.size());
+    std::string out{};
+    for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>((lunghezza >> shift) & 0xFF);
+    for (int shift = 0; shift < 32; shift += 8) out += static_cast<char>((id >> shift) & 0xFF);
+    auto codice = static_cast<uint16_t>(operazione);
+    out += static_cast<char>(codice & 0xFF);
+    out += static_cast<char>(codice >> 8);
+    out += std::string(2, '\0');
+    out += testo;
+    return out;
+}
+
+bool write_all(int fd, std::string_view data) {
+    while (!data.empty()) {
+        ssize_t scritti = write(fd, data.data(), data.size());
+        if (scritti <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(scritti));
+    }
+    return true;
+}
+
+bool read_all(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t letti = read(fd, data, size);
+        if (letti <= 0) return false;
+        data += letti;
+        size -= static_cast<size_t>(letti);
+    }
+    return true;
+}
+
+std::optional<Risposta> leggi(int fd) {
+    unsigned char header[header_size];
+    if (!read_all(fd, reinterpret_cast<char*>(header), header_size)) return {};
+    auto u32 = [&](size_t i) {
+        return static_cast<uint32_t>(header[i] | header[i + 1] << 8 | header[i + 2] << 16 | header[i + 3] << 24);
+    };
+    Risposta risposta{.id = u32(4), .esito = static_cast<uint16_t>(header[8] | header[9] << 8)};
+    risposta.testo.resize(u32(0));
+    if (!read_all(fd, risposta.testo.data(), risposta.testo.size())) return {};
+    return risposta;
+}
+
+// il demone gira in un thread finché il test non gli manda SIGTERM
+class Demone {
+    std::string m_path;
+    std::thread m_thread{};
+    int m_rc = -1;
+
+    public:
+    explicit Demone(std::string path) : m_path(std::move(path)) {
+        m_thread = std::thread{[this] { m_rc = run_daemon(m_path.c_str(), nullptr); }};
+        // una risposta garantisce che il ciclo sia partito e i gestori dei segnali siano installati
+        int fd = connect_to(m_path);
+        CHECK(fd >= 0 && write_all(fd, richiesta(0, Operazione::Statistiche, "")));
+        CHECK(leggi(fd).has_value());
+        close(fd);
+    }
+    int stop() {
+        kill(getpid(), SIGTERM);
+        m_thread.join();
+        return m_rc;
+    }
+};
+
+}
+
+TEST_CASE(daemon_framing) {
+    auto path = socket_path();
+    Demone demone{path};
+    int fd = connect_to(path);
+    // una richiesta spezzata in byte singoli viene ricomposta
+    auto dati = richiesta(7, Operazione::Bilanciamento, "H2 + O2 -> H2O");
+    for (char c : dati) {
+        CHECK(write_all(fd, std::string_view{&c, 1}));
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    auto risposta = leggi(fd);
+    CHECK(risposta.has_value() && risposta->id == 7 && risposta->esito == static_cast<uint16_t>(Esito::Ok));
+    if (risposta.has_value()) CHECK(risposta->testo == "2H2 + O2 -> 2H2O");
+
+    // errore del motore: la connessione resta aperta
+    CHECK(write_all(fd, richiesta(8, Operazione::Massa, "Xx2")));
+    risposta = leggi(fd);
+    CHECK(risposta.has_value() && risposta->id == 8 && risposta->esito == static_cast<uint16_t>(Esito::Errore));
+    CHECK(write_all(fd, richiesta(9, Operazione::Massa, "2H2O")));
+    risposta = leggi(fd);
+    CHECK(risposta.has_value() && risposta->esito == static_cast<uint16_t>(Esito::Ok) && risposta->testo == "36.032");
+    close(fd);
+
+    // le operazioni non implementate e i messaggi troppo lunghi chiudono la connessione dopo la risposta
+    for (auto dati : {richiesta(1, Operazione::Nomenclatura, "H2O"), richiesta(2, Operazione{42}, ""),
+                      richiesta(3, Operazione::Bilanciamento, "", max_message_size + 1)}) {
+        fd = connect_to(path);
+        CHECK(write_all(fd, dati));
+        risposta = leggi(fd);
+        CHECK(risposta.has_value() && risposta->esito == static_cast<uint16_t>(Esito::Protocollo));
+        if (risposta.has_value()) {
+            CHECK(risposta->testo == (risposta->id == 3 ? "Messaggio troppo lungo" : "Operazione non valida"));
+        }
+        CHECK(!leggi(fd).has_value());
+        close(fd);
+    }
+    CHECK(demone.stop() == 0);
+}
+
+TEST_CASE(daemon_batches) {
+    auto path = socket_path();
+    Demone demone{path};
+    // più del doppio delle richieste che entrano in un batch, scritte tutte prima di leggere: il client chiude il suo
+    // lato mentre nel buffer del demone ne restano ancora di complete, e deve comunque ricevere ogni risposta
+    // nell'ordine di invio
+    constexpr uint32_t n = 10000;
+    std::string dati{};
+    for (uint32_t i = 0; i < n; i++) {
+        dati += i % 1000 == 0 ? richiesta(i, Operazione::Bilanciamento, "H2 + O2 -> H2O")
+                              : richiesta(i, Operazione::Massa, "H" + std::to_string(i % 7 + 1));
+    }
+    int fd = connect_to(path);
+    CHECK(write_all(fd, dati));
+    shutdown(fd, SHUT_WR);
+    uint32_t ricevute = 0;
+    while (auto risposta = leggi(fd)) {
+        CHECK(risposta->id == ricevute && risposta->esito == static_cast<uint16_t>(Esito::Ok));
+        ricevute++;
+    }
+    CHECK(ricevute == n);
+    close(fd);
+    CHECK(demone.stop() == 0);
+    CHECK(!std::filesystem::exists(path));
+}
+
+TEST_CASE(daemon_socket_file) {
+    auto path = socket_path();
+    // socket rimasto da un demone terminato male: nessuno accetta connessioni, quindi viene sostituito
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        auto addr = address(path);
+        CHECK(bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0);
+        close(fd);
+    }
+    CHECK(std::filesystem::is_socket(path));
+    Demone demone{path};
+
+    // un socket di un demone attivo invece resta al suo posto
+    CHECK(run_daemon(path.c_str(), nullptr) == 1);
+    int fd = connect_to(path);
+    CHECK(fd >= 0 && write_all(fd, richiesta(1, Operazione::Massa, "H2")));
+    CHECK(leggi(fd).has_value());
+    close(fd);
+    CHECK(demone.stop() == 0);
+
+    // un file qualunque non viene toccato
+    std::ofstream{path} << "dati";
+    CHECK(run_daemon(path.c_str(), nullptr) == 1);
+    CHECK(std::filesystem::is_regular_file(path) && std::filesystem::file_size(path) == 4);
+    std::filesystem::remove(path);
+}
+
+#endif
@@ -0,0 +1,75 @@
+// reti di reazioni: dipendenze, quantità conservate, modi di flusso elementari e limiti dell'enumerazione
+#include "Check.h"
+#include "Network.h"
+
+#include <algorithm>
+#include <string>
+
+static bool contains(const std::vector<VettoreSparso>& vettori, const VettoreSparso& atteso) {
+    return std::ranges::find(vettori, atteso) != vettori.end();
+}
+
+TEST_CASE(network_dependencies) {
+    // il reforming completo è la somma delle altre due reazioni
+    auto analisi = analyze_network(std::string_view{"CH4 + H2O -> CO + 3H2; CO + H2O -> CO2 + H2\n"
+                                                    "CH4 + 2H2O -> CO2 + 4H2"});
+    CHECK(analisi.ok());
+    CHECK(analisi.specie.size() == 5 && analisi.rango == 2);
+    CHECK(analisi.dipendenze.size() == 1);
+    if (analisi.dipendenze.size() == 1) CHECK((analisi.dipendenze.front() == VettoreSparso{{0, -1}, {1, -1}, {2, 1}}));
+
+    auto indipendenti = analyze_network(std::string_view{"CH4 + 2O2 -> CO2 + 2H2O; 2H2 + O2 -> 2H2O"});
+    CHECK(indipendenti.ok() && indipendenti.rango == 2 && indipendenti.dipendenze.empty());
+}
+
+TEST_CASE(network_moieties) {
+    // specie: CH4 0, H2O 1, CO 2, H2 3, CO2 4. il carbonio si conserva, e ogni generatore ha pesi non negativi
+    auto analisi = analyze_network(std::string_view{"CH4 + H2O -> CO + 3H2; CO + H2O -> CO2 + H2"});
+    CHECK(analisi.ok() && !analisi.conservate_limitate);
+    CHECK(contains(analisi.conservate, {{0, 1}, {2, 1}, {4, 1}}));
+    for (const auto& relazione : analisi.conservate) {
+        CHECK(std::ranges::all_of(relazione, [](const auto& entry) { return entry.second > 0; }));
+        // ogni quantità conservata è ortogonale a tutte le reazioni
+        for (const auto& colonna : analisi.colonne) {
+            long long somma = 0;
+            for (const auto& [idx, value] : colonna) {
+                auto it = std::ranges::find(relazione, idx, &std::pair<size_t, long long>::first);
+                if (it != relazione.end()) somma += it->second * value;
+            }
+            CHECK(somma == 0);
+        }
+    }
+}
+
+TEST_CASE(network_flux_modes) {
+    // due vie alternative dal metano all'idrogeno: il reforming diretto e quello in due passi
+    auto analisi = analyze_network(std::string_view{"CH4 + H2O -> CO + 3H2; CO + H2O -> CO2 + H2\n"
+                                                    "CH4 + 2H2O -> CO2 + 4H2"});
+    CHECK(analisi.ok() && !analisi.modi_limitati);
+    CHECK(analisi.modi.size() == 2);
+    CHECK(contains(analisi.modi, {{2, 1}}));
+    CHECK(contains(analisi.modi, {{0, 1}, {1, 1}}));
+    CHECK(analisi.moltiplicatori.empty());
+
+    // un solo modo: la combustione seguita dalla reazione di Boudouard
+    auto catena = analyze_network(std::string_view{"C + O2 -> CO2; CO2 + C -> 2CO"});
+    CHECK(catena.ok() && catena.modi.size() == 1);
+    CHECK((catena.moltiplicatori == VettoreSparso{{0, 1}, {1, 1}}));
+    auto risultato = do_network(QString{"C + O2 -> CO2; CO2 + C -> 2CO"});
+    CHECK(risultato.ok() && risultato.reazione.has_value());
+    if (risultato.reazione.has_value()) {
+        CHECK(format_equazione(risultato.reazione.value()).toStdString() == "2C + O2 -> 2CO");
+    }
+}
+
+TEST_CASE(network_limits) {
+    // una catena più lunga di max_raggi: l'enumerazione si interrompe e l'analisi lo riporta
+    std::string catena{};
+    for (int k = 1; k <= 300; k++) catena += "C" + std::to_string(k) + "H2 + C -> C" + std::to_string(k + 1) + "H2\n";
+    auto analisi = analyze_network(std::string_view{catena});
+    CHECK(analisi.ok());
+    CHECK(analisi.modi_limitati && analisi.modi.empty());
+    CHECK(analisi.conservate_limitate && analisi.conservate.size() == 2);
+    auto testo = format_analisi(analisi).toStdString();
+    CHECK(testo.find("Modi di flusso elementari: troppi da enumerare") != std::string::npos);
+}
@@ -0,0 +1,88 @@
+// lettura delle equazioni in UTF-8 e UTF-16, gruppi, idrati e cariche
+#include "Check.h"
+#include "Actions.h"
+
+#include <string>
+#include <vector>
+
+static std::string balanced(const Risultato& risultato) {
+    if (!risultato.ok() || !risultato.reazione.has_value()) return "ERR " + risultato.errore.toStdString();
+    return format_equazione(risultato.reazione.value()).toStdString();
+}
+
+static std::vector<size_t> quantities(const Reazione& reazione) {
+    std::vector<size_t> out{};
+    for (const auto& composto : reazione.reagenti) out.push_back(static_cast<size_t>(composto.quantity()));
+    for (const auto& composto : reazione.prodotti) out.push_back(static_cast<size_t>(composto.quantity()));
+    return out;
+}
+
+TEST_CASE(surrogates) {
+    // una coppia di surrogati è un solo carattere, sia in UTF-16 che in UTF-8
+    auto utf16 = balance_equation(std::u16string_view{u"H2 + O2 -> H2O\U0001F600"});
+    CHECK(utf16.errore.toStdString() == "Carattere non valido: U+1F600");
+    auto utf8 = balance_equation(std::string_view{"H2 + O2 -> H2O\xF0\x9F\x98\x80"});
+    CHECK(utf8.errore.toStdString() == "Carattere non valido: U+1F600");
+
+    // surrogati isolati
+    std::u16string alto = u"H2 + O2 -> H2O";
+    alto += static_cast<char16_t>(0xD83D);
+    CHECK(balance_equation(std::u16string_view{alto}).errore.toStdString() == "Carattere non valido: U+D83D");
+    std::u16string basso = u"H2 + O2 -> H2O";
+    basso += static_cast<char16_t>(0xDE00);
+    basso += u"X";
+    CHECK(balance_equation(std::u16string_view{basso}).errore.toStdString() == "Carattere non valido: U+DE00");
+
+    CHECK(balanced(balance_equation(std::u16string_view{u"H₂ + O₂ → H₂O"})) == "2H2 + O2 -> 2H2O");
+}
+
+TEST_CASE(truncated_utf8) {
+    // `₂` troncato alla fine del testo
+    auto troncato = balance_equation(std::string_view{"H2 + O2 -> H2O\xE2\x82"});
+    CHECK(troncato.errore.toStdString() == "Carattere non valido: U+FFFD");
+    CHECK(!balance_equation(std::string_view{"H2 + O2 -> H\xE2"}).ok());
+    CHECK(balanced(balance_equation(std::string_view{"H\xE2\x82\x82 + O\xE2\x82\x82 -> H\xE2\x82\x82O"})) ==
+          "2H2 + O2 -> 2H2O");
+}
+
+TEST_CASE(groups_and_hydrates) {
+    CHECK(balanced(balance_equation(std::string_view{"Ca3(PO4)2 + H2SO4 -> CaSO4 + H3PO4"})) ==
+          "Ca3(PO4)2 + 3H2SO4 -> 3CaSO4 + 2H3PO4");
+    CHECK(balanced(balance_equation(std::string_view{"CuSO₄·5H₂O → CuSO₄ + H₂O"})) ==
+          "CuSO4(H2O)5 -> CuSO4 + 5H2O");
+    CHECK(balanced(balance_equation(std::string_view{"Na2CO3*10H2O -> Na2CO3 + H2O"})) ==
+          "Na2CO3(H2O)10 -> Na2CO3 + 10H2O");
+    CHECK(verify_balance(std::string_view{"CuSO₄·5H₂O → CuSO₄ + 5H₂O"}).bilanciata());
+    CHECK(!verify_balance(std::string_view{"CuSO₄·5H₂O → CuSO₄ + 4H₂O"}).bilanciata());
+}
+
+TEST_CASE(charges) {
+    auto redox = balance_equation(std::string_view{"MnO4^- + Fe^2+ + H^+ -> Mn^2+ + Fe^3+ + H2O"});
+    CHECK(redox.ok() && redox.reazione.has_value());
+    if (redox.reazione.has_value()) {
+        CHECK((quantities(redox.reazione.value()) == std::vector<size_t>{1, 5, 8, 1, 5, 4}));
+    }
+    CHECK(balanced(balance_equation(std::string_view{"Fe³⁺ + Cu → Fe²⁺ + Cu²⁺"})) ==
+          "2Fe^3+ + Cu -> 2Fe^2+ + Cu^2+");
+    // gli elementi tornano ma la carica no
+    CHECK(!balance_equation(std::string_view{"Fe^3+ -> Fe^2+"}).testo.isEmpty());
+    auto verifica = verify_balance(std::string_view{"Fe^3+ -> Fe^2+"});
+    CHECK(verifica.ok() && verifica.elementi.empty() && verifica.differenza_carica == 1);
+}
+
+TEST_CASE(number_limits) {
+    // oltre il limite del lexer il numero non viene più troncato
+    CHECK(balance_equation(std::string_view{"H99999999999 -> H2"}).errore.toStdString() == "Numero troppo grande");
+    CHECK(balance_equation(std::string_view{"H₉₉₉₉₉₉₉₉₉₉₉ -> H₂"}).errore.toStdString() ==
+          "Numero troppo grande");
+    CHECK(verify_balance(std::string_view{"12345678901H2 -> H2"}).errore.toStdString() == "Numero troppo grande");
+    CHECK(balance_equation(std::string_view{"H1000000000 -> H2"}).ok());
+
+    CHECK(balance_equation(std::string_view{"Fe^99999999999+ -> Fe"}).errore.toStdString() == "Numero troppo grande");
+    // le cariche di un composto vengono sommate in un int
+    CHECK(balance_equation(std::string_view{"Fe^999999999+^999999999+^999999999+ -> Fe"}).errore.toStdString() ==
+          "Carica troppo grande");
+    // i gruppi annidati dentro un idrato moltiplicano le quantità
+    CHECK(balance_equation(std::string_view{"CuSO4*((((H999999999)999999999)999999999)) -> H2"})
+                  .errore.toStdString() == "Numeri troppo grandi nella reazione");
+}
@@ -0,0 +1,16 @@
+#include "Check.h"
+
+#include <cstring>
+
+// senza argomenti esegue tutti i casi, altrimenti solo quelli il cui nome contiene il primo argomento
+int main(int argc, char* argv[]) {
+    const char* filtro = argc > 1 ? argv[1] : "";
+    for (const auto& [name, fn] : test_cases()) {
+        if (std::strstr(name, filtro) == nullptr) continue;
+        int prima = failures;
+        fn();
+        if (failures != prima) std::fprintf(stderr, "%s: %d controlli falliti\n", name, failures - prima);
+    }
+    if (failures > 0) std::fprintf(stderr, "%d controlli falliti in totale\n", failures);
+    return failures == 0 ? 0 : 1;
+}
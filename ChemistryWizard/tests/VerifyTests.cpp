@@ -0,0 +1,43 @@
+// verifica delle equazioni già bilanciate e aritmetica controllata
+#include "Check.h"
+#include "Actions.h"
+
+#include <limits>
+
+TEST_CASE(checked_arithmetic) {
+    constexpr long long max = std::numeric_limits<long long>::max();
+    constexpr long long min = std::numeric_limits<long long>::min();
+    long long out = 7;
+    CHECK(checked_mul(3, -4, out) && out == -12);
+    CHECK(checked_mul(min, 1, out) && out == min);
+    CHECK(checked_mul(max, -1, out) && out == -max);
+    out = 7;
+    CHECK(!checked_mul(min, -1, out) && out == 7);
+    CHECK(!checked_mul(-1, min, out) && out == 7);
+    CHECK(!checked_mul(min, 2, out));
+    CHECK(!checked_mul(3037000500LL, 3037000500LL, out));
+    CHECK(checked_mul(3037000499LL, 3037000499LL, out) && out == 3037000499LL * 3037000499LL);
+    CHECK(checked_add(min, max, out) && out == -1);
+    CHECK(!checked_add(max, 1, out) && out == -1);
+    CHECK(!checked_add(min, -1, out));
+}
+
+TEST_CASE(verify_results) {
+    CHECK(verify_balance(std::string_view{"2H2 + O2 -> 2H2O"}).bilanciata());
+    CHECK(verify_balance(std::u16string_view{u"2H₂ + O₂ → 2H₂O"}).bilanciata());
+
+    auto sbilanciata = verify_balance(std::string_view{"H2 + O2 -> H2O"});
+    CHECK(sbilanciata.ok() && !sbilanciata.bilanciata());
+    CHECK(format_verifica(sbilanciata).toStdString() == "Non bilanciata: O +1");
+    CHECK(format_verifica(verify_balance(std::string_view{"Fe^3+ -> Fe^2+"})).toStdString() ==
+          "Non bilanciata: carica +1");
+    CHECK(!verify_balance(std::string_view{"H2 + Xx -> H2"}).ok());
+}
+
+TEST_CASE(verify_overflow) {
+    // ogni numero sta nel limite del lexer, il loro prodotto no
+    auto verifica = verify_balance(std::string_view{"(((H999999999)999999999)999999999) -> H2"});
+    CHECK(verifica.errore.toStdString() == "Numeri troppo grandi nella reazione");
+    auto coefficiente = verify_balance(std::string_view{"999999999(H999999999)999999999 -> H2"});
+    CHECK(coefficiente.errore.toStdString() == "Numeri troppo grandi nella reazione");
+}